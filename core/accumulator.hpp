@@ -0,0 +1,86 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef ACCUMULATOR_HPP
+#define ACCUMULATOR_HPP
+
+#include <omp.h>
+
+#include <vector>
+
+#include "core/bitmap.hpp"
+#include "core/mpi.hpp"
+#include "core/type.hpp"
+
+// vertices per bin; a bin's slice of a vertex array should stay cache-resident while it is applied
+#ifndef ACCUMULATOR_BIN_BITS
+#define ACCUMULATOR_BIN_BITS 14
+#endif
+
+// contention-free replacement for write_add/write_min on owned vertices (propagation blocking):
+// add() appends the update to the calling thread's bin for the destination range, and flush() later folds
+// the bins into the vertex array with Op, one bin per thread and without atomics
+template <typename T, typename Op>
+class Accumulator {
+  struct Update {
+    VertexId vertex;
+    T value;
+  };
+  int threads;
+  VertexId begin_v_i;
+  VertexId bins;
+  std::vector<std::vector<Update> > * thread_bins;
+public:
+  Accumulator(int threads, VertexId begin_v_i, VertexId end_v_i) : threads(threads), begin_v_i(begin_v_i) {
+    bins = ((end_v_i - begin_v_i) >> ACCUMULATOR_BIN_BITS) + 1;
+    thread_bins = new std::vector<std::vector<Update> > [threads];
+    for (int t_i=0;t_i<threads;t_i++) {
+      thread_bins[t_i].resize(bins);
+    }
+  }
+  ~Accumulator() {
+    delete [] thread_bins;
+  }
+  // called from within process_edges slots, for owned vertices only
+  void add(VertexId vtx, T value) {
+    thread_bins[omp_get_thread_num()][(vtx - begin_v_i) >> ACCUMULATOR_BIN_BITS].push_back(Update{vtx, value});
+  }
+  // collective; folds all pending updates into array, sets the bits of changed vertices in changed (if given)
+  // and returns how many vertices were newly set there over all ranks
+  VertexId flush(T * array, Bitmap * changed = nullptr) {
+    VertexId changed_vertices = 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:changed_vertices)
+    for (VertexId b_i=0;b_i<bins;b_i++) {
+      for (int t_i=0;t_i<threads;t_i++) {
+        std::vector<Update> & updates = thread_bins[t_i][b_i];
+        for (size_t u_i=0;u_i<updates.size();u_i++) {
+          VertexId vtx = updates[u_i].vertex;
+          T old_value = array[vtx];
+          Op::combine(array[vtx], updates[u_i].value);
+          if (changed!=nullptr && array[vtx]!=old_value && !changed->get_bit(vtx)) {
+            changed->set_bit(vtx);
+            changed_vertices += 1;
+          }
+        }
+        updates.clear();
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &changed_vertices, 1, get_mpi_data_type<VertexId>(), MPI_SUM, MPI_COMM_WORLD);
+    return changed_vertices;
+  }
+};
+
+#endif
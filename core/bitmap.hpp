@@ -17,29 +17,104 @@ Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
 #ifndef BITMAP_HPP
 #define BITMAP_HPP
 
+#include <functional>
+
 #define WORD_OFFSET(i) ((i) >> 6)
 #define BIT_OFFSET(i) ((i) & 0x3f)
 
+// besides the bits, a bitmap can record the positions it sets in a compact queue while they are few (at most one per
+// word), so that sparse subsets can be visited and cleared in O(set bits) instead of O(size/64); only bitmaps that call
+// track_queue() (vertex subsets) keep one
 class Bitmap {
 public:
   size_t size;
   unsigned long * data;
-  Bitmap() : size(0), data(NULL) { }
-  Bitmap(size_t size) : size(size) {
+  size_t * queue;
+  size_t queue_capacity;
+  size_t queue_size; // > queue_capacity once the queue has been dropped
+  unsigned long * dirty; // one bit per word changed since reset_dirty(), once track_dirty() has been called
+  bool all_dirty;
+  std::function<void(long)> account; // if set, told the bytes of every array allocated later (and of all of them on release)
+  Bitmap() : size(0), data(NULL), queue(NULL), queue_capacity(0), queue_size(1), dirty(NULL), all_dirty(true) { }
+  Bitmap(size_t size) : size(size), queue(NULL), queue_capacity(0), dirty(NULL), all_dirty(true) {
     data = new unsigned long [WORD_OFFSET(size)+1];
+    drop_queue();
     clear();
   }
   ~Bitmap() {
+    if (account) {
+      account(-(long)bytes());
+    }
     delete [] data;
+    delete [] queue;
+    delete [] dirty;
+  }
+  // bytes of the bits, the queue and the dirty words
+  size_t bytes() {
+    size_t words = data==NULL ? 0 : WORD_OFFSET(size)+1;
+    size_t dirty_words = dirty==NULL ? 0 : WORD_OFFSET(WORD_OFFSET(size))+1;
+    return sizeof(unsigned long) * (words + dirty_words) + sizeof(size_t) * queue_capacity;
+  }
+  bool has_queue() {
+    return queue_size <= queue_capacity;
+  }
+  // call after writing data directly
+  void drop_queue() {
+    queue_size = queue_capacity + 1;
+  }
+  // start keeping the queue; it takes effect with the next clear()
+  void track_queue() {
+    if (queue==NULL) {
+      queue_capacity = WORD_OFFSET(size)+1;
+      queue = new size_t [queue_capacity];
+      drop_queue();
+      if (account) {
+        account(sizeof(size_t) * queue_capacity);
+      }
+    }
+  }
+  void track_dirty() {
+    if (dirty==NULL) {
+      dirty = new unsigned long [WORD_OFFSET(WORD_OFFSET(size))+1];
+      reset_dirty();
+      all_dirty = true;
+      if (account) {
+        account(sizeof(unsigned long) * (WORD_OFFSET(WORD_OFFSET(size))+1));
+      }
+    }
+  }
+  void reset_dirty() {
+    for (size_t i=0;i<=WORD_OFFSET(WORD_OFFSET(size));i++) {
+      dirty[i] = 0;
+    }
+    all_dirty = false;
+  }
+  unsigned long word_dirty(size_t w_i) {
+    return dirty[WORD_OFFSET(w_i)] & (1ul<<BIT_OFFSET(w_i));
+  }
+  void mark_dirty(size_t i) {
+    if (dirty!=NULL && !word_dirty(WORD_OFFSET(i))) {
+      __sync_fetch_and_or(dirty+WORD_OFFSET(WORD_OFFSET(i)), 1ul<<BIT_OFFSET(WORD_OFFSET(i)));
+    }
   }
   void clear() {
-    size_t bm_size = WORD_OFFSET(size);
-    #pragma omp parallel for
-    for (size_t i=0;i<=bm_size;i++) {
-      data[i] = 0;
+    all_dirty = true;
+    if (has_queue()) {
+      for (size_t q_i=0;q_i<queue_size;q_i++) {
+        data[WORD_OFFSET(queue[q_i])] = 0;
+      }
+    } else {
+      size_t bm_size = WORD_OFFSET(size);
+      #pragma omp parallel for
+      for (size_t i=0;i<=bm_size;i++) {
+        data[i] = 0;
+      }
     }
+    queue_size = queue==NULL ? queue_capacity + 1 : 0;
   }
   void fill() {
+    all_dirty = true;
+    drop_queue();
     size_t bm_size = WORD_OFFSET(size);
     #pragma omp parallel for
     for (size_t i=0;i<bm_size;i++) {
@@ -54,7 +129,22 @@ public:
     return data[WORD_OFFSET(i)] & (1ul<<BIT_OFFSET(i));
   }
   void set_bit(size_t i) {
-    __sync_fetch_and_or(data+WORD_OFFSET(i), 1ul<<BIT_OFFSET(i));
+    unsigned long mask = 1ul<<BIT_OFFSET(i);
+    unsigned long old_word = __sync_fetch_and_or(data+WORD_OFFSET(i), mask);
+    if (!(old_word & mask)) {
+      mark_dirty(i);
+      if (has_queue()) {
+        size_t q_i = __sync_fetch_and_add(&queue_size, 1);
+        if (q_i < queue_capacity) {
+          queue[q_i] = i;
+        }
+      }
+    }
+  }
+  void clear_bit(size_t i) {
+    drop_queue();
+    mark_dirty(i);
+    __sync_fetch_and_and(data+WORD_OFFSET(i), ~(1ul<<BIT_OFFSET(i)));
   }
 };
 
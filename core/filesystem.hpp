@@ -21,9 +21,16 @@ Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
 #include <stdlib.h>
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <string>
+#include <vector>
+
+#include "core/type.hpp"
+
 inline bool file_exists(std::string filename) {
   struct stat st;
   return stat(filename.c_str(), &st)==0;
@@ -35,4 +42,23 @@ inline long file_size(std::string filename) {
   return st.st_size;
 }
 
+// read a (small) batch of edges, stored in the same binary format as the graph
+template <typename EdgeData>
+std::vector<EdgeUnit<EdgeData> > read_edge_batch(std::string path) {
+  long bytes = file_size(path);
+  assert(bytes % sizeof(EdgeUnit<EdgeData>) == 0);
+  std::vector<EdgeUnit<EdgeData> > batch(bytes / sizeof(EdgeUnit<EdgeData>));
+  int fin = open(path.c_str(), O_RDONLY);
+  assert(fin!=-1);
+  char * data = (char *)batch.data();
+  long read_bytes = 0;
+  while (read_bytes < bytes) {
+    long curr_read_bytes = read(fin, data + read_bytes, bytes - read_bytes);
+    assert(curr_read_bytes>0);
+    read_bytes += curr_read_bytes;
+  }
+  close(fin);
+  return batch;
+}
+
 #endif
\ No newline at end of file
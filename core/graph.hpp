@@ -23,6 +23,7 @@ Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
 #include <unistd.h>
 #include <fcntl.h>
 #include <malloc.h>
+#include <limits.h>
 #include <sys/mman.h>
 #include <numa.h>
 #include <omp.h>
@@ -32,12 +33,16 @@ Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
 #include <thread>
 #include <mutex>
 #include <functional>
+#include <algorithm>
 
+#include "core/accumulator.hpp"
 #include "core/atomic.hpp"
 #include "core/bitmap.hpp"
 #include "core/constants.hpp"
 #include "core/filesystem.hpp"
+#include "core/memory.hpp"
 #include "core/mpi.hpp"
+#include "core/table.hpp"
 #include "core/time.hpp"
 #include "core/type.hpp"
 
@@ -49,7 +54,8 @@ enum ThreadStatus {
 enum MessageTag {
   ShuffleGraph,
   PassMessage,
-  GatherVertexArray
+  GatherVertexArray,
+  ReduceCandidates
 };
 
 struct ThreadState {
@@ -93,6 +99,14 @@ struct MsgUnit {
   MsgData msg_data;
 } __attribute__((packed));
 
+// the unit of a variable-length message: its elements are stored at offset (in bytes) in the payload buffer
+// that travels with the buffer of units
+struct MsgSpan {
+  VertexId vertex;
+  size_t offset;
+  size_t length;
+};
+
 template <typename EdgeData = Empty>
 class Graph {
 public:
@@ -140,10 +154,24 @@ public:
 
   size_t local_send_buffer_limit;
   MessageBuffer ** local_send_buffer; // MessageBuffer* [threads]; numa-aware
+  MessageBuffer ** local_payload_buffer; // MessageBuffer* [threads]; numa-aware
 
   int current_send_part_id;
   MessageBuffer *** send_buffer; // MessageBuffer* [partitions] [sockets]; numa-aware
   MessageBuffer *** recv_buffer; // MessageBuffer* [partitions] [sockets]; numa-aware
+  // the elements of variable-length messages; count is in bytes
+  MessageBuffer *** send_payload_buffer; // MessageBuffer* [partitions] [sockets]; numa-aware
+  MessageBuffer *** recv_payload_buffer; // MessageBuffer* [partitions] [sockets]; numa-aware
+  std::mutex * payload_lock; // [sockets]; serializes flushes into the send payload buffers
+
+  size_t message_unit_bytes; // bytes per message unit of the running process_edges
+  size_t message_array_bytes; // bytes of the elements of each array message
+  bool list_messages; // whether the units are MsgSpans with payloads
+
+  MemoryMap memory; // bytes by structure and numa node; vertex arrays and adjacency structures are mapped through it
+  std::string adjacency_dir; // if not empty, adjacency lists are kept in files there instead of in memory
+  bool sort_adjacency; // if set, loads sort every adjacency list by neighbour and drop repeated edges
+  bool drop_self_loops; // with sort_adjacency, loads also drop self-loops
 
   Graph(int num_threads) {
 #if 0
@@ -197,19 +225,25 @@ public:
       nodestring[s_i*2-1] = ',';
       nodestring[s_i*2] = '0'+s_i;
     }
-    nodestring[sockets*2+1] = '\0';
+    nodestring[sockets*2-1] = '\0';
     struct bitmask * nodemask = numa_parse_nodestring(nodestring);
     numa_set_interleave_mask(nodemask);
+    numa_bitmask_free(nodemask);
 
     omp_set_dynamic(0);
     omp_set_num_threads(threads);
     thread_state = new ThreadState * [threads];
     local_send_buffer_limit = 16;
     local_send_buffer = new MessageBuffer * [threads];
+    local_payload_buffer = new MessageBuffer * [threads];
     for (int t_i=0;t_i<threads;t_i++) {
       thread_state[t_i] = (ThreadState*)numa_alloc_onnode( sizeof(ThreadState), get_socket_id(t_i));
       local_send_buffer[t_i] = (MessageBuffer*)numa_alloc_onnode( sizeof(MessageBuffer), get_socket_id(t_i));
       local_send_buffer[t_i]->init(get_socket_id(t_i));
+      memory.account("local_send_buffer", get_socket_id(t_i), local_send_buffer[t_i]->capacity);
+      local_payload_buffer[t_i] = (MessageBuffer*)numa_alloc_onnode( sizeof(MessageBuffer), get_socket_id(t_i));
+      local_payload_buffer[t_i]->init(get_socket_id(t_i));
+      memory.account("local_payload_buffer", get_socket_id(t_i), local_payload_buffer[t_i]->capacity);
     }
     #pragma omp parallel for
     for (int t_i=0;t_i<threads;t_i++) {
@@ -228,22 +262,119 @@ public:
     MPI_Comm_size(MPI_COMM_WORLD, &partitions);
     send_buffer = new MessageBuffer ** [partitions];
     recv_buffer = new MessageBuffer ** [partitions];
+    send_payload_buffer = new MessageBuffer ** [partitions];
+    recv_payload_buffer = new MessageBuffer ** [partitions];
     for (int i=0;i<partitions;i++) {
       send_buffer[i] = new MessageBuffer * [sockets];
       recv_buffer[i] = new MessageBuffer * [sockets];
+      send_payload_buffer[i] = new MessageBuffer * [sockets];
+      recv_payload_buffer[i] = new MessageBuffer * [sockets];
       for (int s_i=0;s_i<sockets;s_i++) {
         send_buffer[i][s_i] = (MessageBuffer*)numa_alloc_onnode( sizeof(MessageBuffer), s_i);
         send_buffer[i][s_i]->init(s_i);
         recv_buffer[i][s_i] = (MessageBuffer*)numa_alloc_onnode( sizeof(MessageBuffer), s_i);
         recv_buffer[i][s_i]->init(s_i);
+        memory.account("send_buffer", s_i, send_buffer[i][s_i]->capacity);
+        memory.account("recv_buffer", s_i, recv_buffer[i][s_i]->capacity);
+        send_payload_buffer[i][s_i] = (MessageBuffer*)numa_alloc_onnode( sizeof(MessageBuffer), s_i);
+        send_payload_buffer[i][s_i]->init(s_i);
+        recv_payload_buffer[i][s_i] = (MessageBuffer*)numa_alloc_onnode( sizeof(MessageBuffer), s_i);
+        recv_payload_buffer[i][s_i]->init(s_i);
+        memory.account("send_payload_buffer", s_i, send_payload_buffer[i][s_i]->capacity);
+        memory.account("recv_payload_buffer", s_i, recv_payload_buffer[i][s_i]->capacity);
       }
     }
+    payload_lock = new std::mutex [sockets];
+    message_unit_bytes = 0;
+    message_array_bytes = 0;
+    list_messages = false;
 
     alpha = 8 * (partitions - 1);
+    sort_adjacency = false;
+    drop_self_loops = false;
+
+    partition_offset = nullptr;
+    local_partition_offset = nullptr;
+    outgoing_edges = incoming_edges = nullptr;
+    outgoing_adj_bitmap = incoming_adj_bitmap = nullptr;
+    outgoing_adj_index = incoming_adj_index = nullptr;
+    outgoing_adj_list = incoming_adj_list = nullptr;
+    compressed_outgoing_adj_vertices = compressed_incoming_adj_vertices = nullptr;
+    compressed_outgoing_adj_index = compressed_incoming_adj_index = nullptr;
+    tuned_chunks_dense = tuned_chunks_sparse = nullptr;
 
     MPI_Barrier(MPI_COMM_WORLD);
   }
 
+  // vertex arrays, adjacency lists and indices are mapped through memory and go away with it
+  ~Graph() {
+    for (int t_i=0;t_i<threads;t_i++) {
+      free_message_buffer(local_send_buffer[t_i]);
+      free_message_buffer(local_payload_buffer[t_i]);
+      numa_free(thread_state[t_i], sizeof(ThreadState));
+    }
+    delete [] local_send_buffer;
+    delete [] local_payload_buffer;
+    delete [] thread_state;
+    for (int i=0;i<partitions;i++) {
+      for (int s_i=0;s_i<sockets;s_i++) {
+        free_message_buffer(send_buffer[i][s_i]);
+        free_message_buffer(recv_buffer[i][s_i]);
+        free_message_buffer(send_payload_buffer[i][s_i]);
+        free_message_buffer(recv_payload_buffer[i][s_i]);
+      }
+      delete [] send_buffer[i];
+      delete [] recv_buffer[i];
+      delete [] send_payload_buffer[i];
+      delete [] recv_payload_buffer[i];
+    }
+    delete [] send_buffer;
+    delete [] recv_buffer;
+    delete [] send_payload_buffer;
+    delete [] recv_payload_buffer;
+    delete [] payload_lock;
+
+    delete [] partition_offset;
+    delete [] local_partition_offset;
+    // symmetric graphs share one adjacency structure (and one set of chunks) between both views
+    if (incoming_adj_bitmap!=outgoing_adj_bitmap) {
+      free_adjacency(incoming_edges, incoming_adj_bitmap, incoming_adj_index, incoming_adj_list, compressed_incoming_adj_vertices, compressed_incoming_adj_index);
+    }
+    free_adjacency(outgoing_edges, outgoing_adj_bitmap, outgoing_adj_index, outgoing_adj_list, compressed_outgoing_adj_vertices, compressed_outgoing_adj_index);
+    if (tuned_chunks_sparse!=tuned_chunks_dense) {
+      free_chunks(tuned_chunks_sparse);
+    }
+    free_chunks(tuned_chunks_dense);
+  }
+
+  void free_message_buffer(MessageBuffer * buffer) {
+    numa_free(buffer->data, buffer->capacity);
+    numa_free(buffer, sizeof(MessageBuffer));
+  }
+
+  // release the per-socket tables of one direction of the adjacency
+  void free_adjacency(EdgeId * adj_edges, Bitmap ** adj_bitmap, EdgeId ** adj_index, AdjUnit<EdgeData> ** adj_list, VertexId * compressed_adj_vertices, CompressedAdjIndexUnit ** compressed_adj_index) {
+    if (adj_bitmap!=nullptr) {
+      for (int s_i=0;s_i<sockets;s_i++) {
+        delete adj_bitmap[s_i];
+      }
+    }
+    delete [] adj_bitmap;
+    delete [] adj_edges;
+    delete [] adj_index;
+    delete [] adj_list;
+    delete [] compressed_adj_vertices;
+    delete [] compressed_adj_index;
+  }
+
+  void free_chunks(ThreadState ** chunks) {
+    if (chunks==nullptr) return;
+    for (int i=0;i<partitions;i++) {
+      delete [] chunks[i];
+    }
+    delete [] chunks;
+  }
+
   // fill a vertex array with a specific value
   template<typename T>
   void fill_vertex_array(T * array, T value) {
@@ -253,36 +384,116 @@ public:
     }
   }
 
-  // allocate a numa-aware vertex array
+  // allocate a numa-aware vertex array (of width elements per vertex, vertex v's at array + v * width)
   template<typename T>
-  T * alloc_vertex_array() {
-    char * array = (char *)mmap(NULL, sizeof(T) * vertices, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    assert(array!=NULL);
+  T * alloc_vertex_array(size_t width = 1) {
+    size_t bytes = sizeof(T) * width * vertices;
+    char * array = memory.map("vertex arrays", bytes);
+    // both ends round down, so a page straddling two sockets' ranges goes to the higher socket
+    size_t granularity = page_granularity(bytes);
     for (int s_i=0;s_i<sockets;s_i++) {
-      numa_tonode_memory(array + sizeof(T) * local_partition_offset[s_i], sizeof(T) * (local_partition_offset[s_i+1] - local_partition_offset[s_i]), s_i);
+      size_t begin = sizeof(T) * width * local_partition_offset[s_i] / granularity * granularity;
+      size_t end = s_i==sockets-1 ? mapped_size(bytes) : sizeof(T) * width * local_partition_offset[s_i+1] / granularity * granularity;
+      if (end > begin) {
+        memory.bind(array, begin, end - begin, s_i);
+      }
     }
     return (T*)array;
   }
 
   // deallocate a vertex array
   template<typename T>
-  T * dealloc_vertex_array(T * array) {
-    numa_free(array, sizeof(T) * vertices);
+  void dealloc_vertex_array(T * array) {
+    memory.unmap(array);
   }
 
   // allocate a numa-oblivious vertex array
   template<typename T>
   T * alloc_interleaved_vertex_array() {
-    T * array = (T *)numa_alloc_interleaved( sizeof(T) * vertices );
-    assert(array!=NULL);
-    return array;
+    size_t bytes = sizeof(T) * vertices;
+    char * array = memory.map("vertex arrays", bytes);
+    numa_interleave_memory(array, mapped_size(bytes), numa_all_nodes_ptr);
+    return (T*)array;
+  }
+
+  // keep the adjacency lists of the next load in files under dir (ideally a node-local disk) instead of in memory;
+  // vertex arrays and adjacency indices stay in memory, and dense iterations read ahead the lists they will stream
+  void store_adjacency_in(std::string dir) {
+    adjacency_dir = dir;
+  }
+
+  // let the next load sort each adjacency list by neighbour and keep one edge per neighbour (the lightest one
+  // if edges carry data), optionally without self-loops; degrees, edge counts and indices follow the result
+  void sort_adjacency_on_load(bool drop_self_loops = false) {
+    sort_adjacency = true;
+    this->drop_self_loops = drop_self_loops;
+  }
+
+  // allocate the adjacency list of a socket, in memory or in a file under adjacency_dir
+  char * alloc_adj_list(std::string name, size_t bytes, int s_i) {
+    if (adjacency_dir=="") {
+      return alloc_on_node(name, bytes, s_i);
+    }
+    char path[4096];
+    snprintf(path, 4096, "%s/gemini.%d.%s.%d.%d", adjacency_dir.c_str(), getpid(), name.c_str(), partition_id, s_i);
+    return memory.map_file(name, bytes, path);
+  }
+
+  // start reading the incoming adjacency that the dense step over partition i streams, if it is kept in files
+  void prefetch_dense_step(int i) {
+    if (adjacency_dir=="") return;
+    for (int s_i=0;s_i<sockets;s_i++) {
+      VertexId begin_p_v_i = compressed_incoming_adj_vertices[s_i];
+      VertexId end_p_v_i = 0;
+      for (int t_i=0;t_i<threads;t_i++) {
+        if (get_socket_id(t_i)!=s_i) continue;
+        begin_p_v_i = std::min(begin_p_v_i, tuned_chunks_dense[i][t_i].curr);
+        end_p_v_i = std::max(end_p_v_i, tuned_chunks_dense[i][t_i].end);
+      }
+      if (end_p_v_i <= begin_p_v_i) continue;
+      size_t begin_byte = unit_size * compressed_incoming_adj_index[s_i][begin_p_v_i].index / PAGESIZE * PAGESIZE;
+      size_t end_byte = unit_size * compressed_incoming_adj_index[s_i][end_p_v_i].index;
+      if (end_byte > begin_byte) {
+        madvise((char *)incoming_adj_list[s_i] + begin_byte, end_byte - begin_byte, MADV_WILLNEED);
+      }
+    }
+  }
+
+  // allocate bytes of a graph structure on a numa node
+  char * alloc_on_node(std::string name, size_t bytes, int s_i) {
+    char * data = memory.map(name, bytes);
+    memory.bind(data, 0, mapped_size(bytes), s_i);
+    return data;
+  }
+
+  // grow a message buffer, accounting the growth to its socket
+  void resize_message_buffer(MessageBuffer * buffer, size_t new_capacity, const char * name) {
+    if (new_capacity > buffer->capacity) {
+      size_t capacity = buffer->capacity;
+      buffer->resize(new_capacity);
+      memory.account(name, buffer->socket, buffer->capacity - capacity);
+    }
+  }
+
+  // print the bytes of each structure per numa node and on huge pages, and the peak of this rank
+  void print_memory_report() {
+    for (int i=0;i<partitions;i++) {
+      if (i==partition_id) {
+        memory.print(partition_id);
+        fflush(stdout);
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+    }
   }
 
   // dump a vertex array to path
   template<typename T>
   void dump_vertex_array(T * array, std::string path) {
     long file_length = sizeof(T) * vertices;
-    if (!file_exists(path) || file_size(path) != file_length) {
+    // decide on one rank so that all ranks agree on whether to enter the barrier
+    int need_create = !file_exists(path) || file_size(path) != file_length;
+    MPI_Bcast(&need_create, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    if (need_create) {
       if (partition_id==0) {
         FILE * fout = fopen(path.c_str(), "wb");
         char * buffer = new char [PAGESIZE];
@@ -296,6 +507,7 @@ public:
           }
         }
         fclose(fout);
+        delete [] buffer;
       }
       MPI_Barrier(MPI_COMM_WORLD);
     }
@@ -303,7 +515,7 @@ public:
     assert(fd!=-1);
     long offset = sizeof(T) * partition_offset[partition_id];
     long end_offset = sizeof(T) * partition_offset[partition_id+1];
-    void * data = (void *)array;
+    char * data = (char *)array;
     assert(lseek(fd, offset, SEEK_SET)!=-1);
     while (offset < end_offset) {
       long bytes = write(fd, data + offset, end_offset - offset);
@@ -324,7 +536,7 @@ public:
     assert(fd!=-1);
     long offset = sizeof(T) * partition_offset[partition_id];
     long end_offset = sizeof(T) * partition_offset[partition_id+1];
-    void * data = (void *)array;
+    char * data = (char *)array;
     assert(lseek(fd, offset, SEEK_SET)!=-1);
     while (offset < end_offset) {
       long bytes = read(fd, data + offset, end_offset - offset);
@@ -351,9 +563,183 @@ public:
     }
   }
 
+  // merge per-rank candidate lists up a binomial tree and broadcast the result from rank 0; each list holds at most k entries, so this moves O(k*P) data
+  template<typename T>
+  void reduce_candidates(std::vector<T> & candidates, std::function<void(std::vector<T> &, std::vector<T> &)> merge) {
+    for (int step=1;step<partitions;step*=2) {
+      if (partition_id % (2 * step) == step) {
+        MPI_Send(candidates.data(), sizeof(T) * candidates.size(), MPI_CHAR, partition_id - step, ReduceCandidates, MPI_COMM_WORLD);
+        break;
+      }
+      if (partition_id % (2 * step) == 0 && partition_id + step < partitions) {
+        MPI_Status recv_status;
+        MPI_Probe(partition_id + step, ReduceCandidates, MPI_COMM_WORLD, &recv_status);
+        int length;
+        MPI_Get_count(&recv_status, MPI_CHAR, &length);
+        std::vector<T> received(length / sizeof(T));
+        MPI_Recv(received.data(), length, MPI_CHAR, partition_id + step, ReduceCandidates, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        merge(candidates, received);
+      }
+    }
+    size_t count = candidates.size();
+    MPI_Bcast(&count, 1, get_mpi_data_type<size_t>(), 0, MPI_COMM_WORLD);
+    candidates.resize(count);
+    MPI_Bcast(candidates.data(), sizeof(T) * count, MPI_CHAR, 0, MPI_COMM_WORLD);
+  }
+
+  // the k largest (or smallest) entries of a vertex array as (vertex, value) pairs, best first with ties going to the lower vertex id; only vertices passing filter (if given) are considered, and the result is valid on all ranks
+  template<typename T>
+  std::vector<std::pair<VertexId,T>> select_k(T * array, size_t k, bool largest, std::function<bool(VertexId)> filter = nullptr) {
+    typedef std::pair<VertexId,T> Candidate;
+    auto better = [largest](const Candidate & a, const Candidate & b) {
+      if (a.second != b.second) {
+        return largest ? a.second > b.second : a.second < b.second;
+      }
+      return a.first < b.first;
+    };
+    std::vector<std::vector<Candidate>> thread_candidates(threads);
+    #pragma omp parallel for
+    for (VertexId v_i=partition_offset[partition_id];v_i<partition_offset[partition_id+1];v_i++) {
+      if (filter!=nullptr && !filter(v_i)) continue;
+      // a heap ordered by better keeps the worst kept candidate at the front
+      std::vector<Candidate> & heap = thread_candidates[omp_get_thread_num()];
+      Candidate candidate(v_i, array[v_i]);
+      if (heap.size() < k) {
+        heap.push_back(candidate);
+        std::push_heap(heap.begin(), heap.end(), better);
+      } else if (k > 0 && better(candidate, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), better);
+        heap.back() = candidate;
+        std::push_heap(heap.begin(), heap.end(), better);
+      }
+    }
+    auto merge = [&](std::vector<Candidate> & a, std::vector<Candidate> & b) {
+      a.insert(a.end(), b.begin(), b.end());
+      std::sort(a.begin(), a.end(), better);
+      if (a.size() > k) {
+        a.resize(k);
+      }
+    };
+    std::vector<Candidate> candidates;
+    for (int t_i=0;t_i<threads;t_i++) {
+      merge(candidates, thread_candidates[t_i]);
+    }
+    reduce_candidates<Candidate>(candidates, merge);
+    return candidates;
+  }
+
+  template<typename T>
+  std::vector<std::pair<VertexId,T>> top_k(T * array, size_t k, std::function<bool(VertexId)> filter = nullptr) {
+    return select_k(array, k, true, filter);
+  }
+
+  template<typename T>
+  std::vector<std::pair<VertexId,T>> bottom_k(T * array, size_t k, std::function<bool(VertexId)> filter = nullptr) {
+    return select_k(array, k, false, filter);
+  }
+
+  // (vertices, T()) if no vertex passes filter
+  template<typename T>
+  std::pair<VertexId,T> arg_max(T * array, std::function<bool(VertexId)> filter = nullptr) {
+    std::vector<std::pair<VertexId,T>> result = select_k(array, 1, true, filter);
+    return result.empty() ? std::make_pair(vertices, T()) : result[0];
+  }
+
+  template<typename T>
+  std::pair<VertexId,T> arg_min(T * array, std::function<bool(VertexId)> filter = nullptr) {
+    std::vector<std::pair<VertexId,T>> result = select_k(array, 1, false, filter);
+    return result.empty() ? std::make_pair(vertices, T()) : result[0];
+  }
+
+  // number of owned vertices per bucket over all ranks; vertices mapped outside [0, buckets) are skipped
+  std::vector<VertexId> histogram(std::function<long(VertexId)> bucket, long buckets) {
+    std::vector<VertexId> counts(buckets, 0);
+    std::vector<std::vector<VertexId>> thread_counts(threads, std::vector<VertexId>(buckets, 0));
+    #pragma omp parallel for
+    for (VertexId v_i=partition_offset[partition_id];v_i<partition_offset[partition_id+1];v_i++) {
+      long b_i = bucket(v_i);
+      if (b_i >= 0 && b_i < buckets) {
+        thread_counts[omp_get_thread_num()][b_i] += 1;
+      }
+    }
+    for (int t_i=0;t_i<threads;t_i++) {
+      for (long b_i=0;b_i<buckets;b_i++) {
+        counts[b_i] += thread_counts[t_i][b_i];
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, counts.data(), buckets, get_mpi_data_type<VertexId>(), MPI_SUM, MPI_COMM_WORLD);
+    return counts;
+  }
+
+  // number of vertices satisfying predicate over all ranks
+  VertexId count_vertices(std::function<bool(VertexId)> predicate) {
+    VertexId count = 0;
+    #pragma omp parallel for reduction(+:count)
+    for (VertexId v_i=partition_offset[partition_id];v_i<partition_offset[partition_id+1];v_i++) {
+      if (predicate(v_i)) {
+        count += 1;
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &count, 1, get_mpi_data_type<VertexId>(), MPI_SUM, MPI_COMM_WORLD);
+    return count;
+  }
+
+  // an undirected graph keeps every edge at the owner of its destination, so the owned vertices find all their
+  // neighbours by transposing the local outgoing lists: afterwards, those of owned vertex partition_offset[partition_id] + v_i
+  // are adj[index[v_i]] to adj[index[v_i+1]] (in no particular order), each with the data of its edge
+  void transpose_owned_adjacency(std::vector<EdgeId> & index, std::vector<AdjUnit<EdgeData> > & adj) {
+    VertexId begin_v_i = partition_offset[partition_id];
+    index.assign(owned_vertices + 1, 0);
+    for (int s_i=0;s_i<sockets;s_i++) {
+      #pragma omp parallel for
+      for (VertexId p_v_i=0;p_v_i<compressed_outgoing_adj_vertices[s_i];p_v_i++) {
+        for (EdgeId e_i=compressed_outgoing_adj_index[s_i][p_v_i].index;e_i<compressed_outgoing_adj_index[s_i][p_v_i+1].index;e_i++) {
+          __sync_fetch_and_add(&index[outgoing_adj_list[s_i][e_i].neighbour - begin_v_i + 1], 1);
+        }
+      }
+    }
+    for (VertexId v_i=0;v_i<owned_vertices;v_i++) {
+      index[v_i+1] += index[v_i];
+    }
+    std::vector<EdgeId> position(index.begin(), index.end() - 1);
+    adj.resize(index[owned_vertices]);
+    for (int s_i=0;s_i<sockets;s_i++) {
+      #pragma omp parallel for
+      for (VertexId p_v_i=0;p_v_i<compressed_outgoing_adj_vertices[s_i];p_v_i++) {
+        VertexId src = compressed_outgoing_adj_index[s_i][p_v_i].vertex;
+        for (EdgeId e_i=compressed_outgoing_adj_index[s_i][p_v_i].index;e_i<compressed_outgoing_adj_index[s_i][p_v_i+1].index;e_i++) {
+          VertexId dst = outgoing_adj_list[s_i][e_i].neighbour;
+          EdgeId pos = __sync_fetch_and_add(&position[dst - begin_v_i], 1);
+          adj[pos] = outgoing_adj_list[s_i][e_i];
+          adj[pos].neighbour = src;
+        }
+      }
+    }
+  }
+
   // allocate a vertex subset
   VertexSubset * alloc_vertex_subset() {
-    return new VertexSubset(vertices);
+    VertexSubset * subset = new VertexSubset(vertices);
+    account_bitmap(subset, "vertex_subset");
+    subset->track_queue();
+    subset->clear();
+    return subset;
+  }
+
+  // account a bitmap's arrays, including the queue and dirty words it may allocate later, until it is deleted
+  // (which has to happen before the graph goes away)
+  void account_bitmap(Bitmap * bitmap, std::string name) {
+    MemoryMap * memory_map = &memory;
+    bitmap->account = [memory_map, name](long bytes) {
+      memory_map->account(name, -1, bytes);
+    };
+    bitmap->account(bitmap->bytes());
+  }
+
+  // allocate an accumulator for updates to owned vertices from sparse slots
+  template<typename T, typename Op = SumReduction<T>>
+  Accumulator<T, Op> * alloc_accumulator() {
+    return new Accumulator<T, Op>(threads, partition_offset[partition_id], partition_offset[partition_id+1]);
   }
 
   int get_partition_id(VertexId v_i){
@@ -380,6 +766,66 @@ public:
 
   // load a directed graph and make it undirected
   void load_undirected_from_directed(std::string path, VertexId vertices) {
+    load_symmetric_storage(path, vertices, true);
+  }
+
+  // load a graph whose file already lists every edge in both directions; like an undirected load, the outgoing and
+  // incoming views then share one adjacency structure, but the file's edges are stored as they are
+  void load_symmetric(std::string path, VertexId vertices) {
+    load_symmetric_storage(path, vertices, false);
+  }
+
+  // symmetric storage: each stored edge (src, dst) lives at the owner of dst, and the sparse (outgoing) and dense
+  // (incoming) views are the same lists, indices, bitmaps and degrees; mirror adds the reverse of every file edge
+  void load_symmetric_storage(std::string path, VertexId vertices, bool mirror) {
+    long total_bytes = file_size(path.c_str());
+    EdgeId edges = total_bytes / edge_unit_size;
+    EdgeId read_edges = edges / partitions;
+    if (partition_id==partitions-1) {
+      read_edges += edges % partitions;
+    }
+    long bytes_to_read = edge_unit_size * read_edges;
+    long read_offset = edge_unit_size * (edges / partitions * partition_id);
+    long read_bytes;
+    int fin = open(path.c_str(), O_RDONLY);
+    load_symmetric_edges(vertices, edges, mirror,
+      [&]() {
+        assert(lseek(fin, read_offset, SEEK_SET)==read_offset);
+        read_bytes = 0;
+      },
+      [&](EdgeUnit<EdgeData> * buffer) {
+        if (read_bytes >= bytes_to_read) return (EdgeId)0;
+        long curr_read_bytes = read(fin, buffer, std::min(bytes_to_read - read_bytes, (long)(edge_unit_size * CHUNKSIZE)));
+        assert(curr_read_bytes>=0);
+        read_bytes += curr_read_bytes;
+        return (EdgeId)(curr_read_bytes / edge_unit_size);
+      }
+    );
+    close(fin);
+  }
+
+  // load a symmetric graph from edges in memory: each rank passes its own share (any split will do) of a list that
+  // already holds every edge in both directions, e.g. a graph derived from another one, and nothing goes to disk
+  void load_symmetric_from_edges(const std::vector<EdgeUnit<EdgeData>> & local_edges, VertexId vertices) {
+    EdgeId edges = local_edges.size();
+    MPI_Allreduce(MPI_IN_PLACE, &edges, 1, get_mpi_data_type<EdgeId>(), MPI_SUM, MPI_COMM_WORLD);
+    size_t position;
+    load_symmetric_edges(vertices, edges, false,
+      [&]() {
+        position = 0;
+      },
+      [&](EdgeUnit<EdgeData> * buffer) {
+        size_t chunk = std::min(local_edges.size() - position, (size_t)CHUNKSIZE);
+        std::copy(local_edges.begin() + position, local_edges.begin() + position + chunk, buffer);
+        position += chunk;
+        return (EdgeId)chunk;
+      }
+    );
+  }
+
+  // the symmetric load proper; this rank's share of the |E| edges is read with rewind_edges() followed by
+  // read_edges(buffer) until it returns 0 (at most CHUNKSIZE edges at a time), three times over
+  void load_symmetric_edges(VertexId vertices, EdgeId edges, bool mirror, std::function<void()> rewind_edges, std::function<EdgeId(EdgeUnit<EdgeData> *)> read_edges) {
     double prep_time = 0;
     prep_time -= MPI_Wtime();
 
@@ -388,46 +834,31 @@ public:
     MPI_Datatype vid_t = get_mpi_data_type<VertexId>();
 
     this->vertices = vertices;
-    long total_bytes = file_size(path.c_str());
-    this->edges = total_bytes / edge_unit_size;
+    this->edges = edges;
     #ifdef PRINT_DEBUG_MESSAGES
     if (partition_id==0) {
       printf("|V| = %lu, |E| = %lu\n", vertices, edges);
     }
     #endif
 
-    EdgeId read_edges = edges / partitions;
-    if (partition_id==partitions-1) {
-      read_edges += edges % partitions;
-    }
-    long bytes_to_read = edge_unit_size * read_edges;
-    long read_offset = edge_unit_size * (edges / partitions * partition_id);
-    long read_bytes;
-    int fin = open(path.c_str(), O_RDONLY);
     EdgeUnit<EdgeData> * read_edge_buffer = new EdgeUnit<EdgeData> [CHUNKSIZE];
+    memory.account("loading buffers", -1, sizeof(EdgeUnit<EdgeData>) * CHUNKSIZE);
 
     out_degree = alloc_interleaved_vertex_array<VertexId>();
     for (VertexId v_i=0;v_i<vertices;v_i++) {
       out_degree[v_i] = 0;
     }
-    assert(lseek(fin, read_offset, SEEK_SET)==read_offset);
-    read_bytes = 0;
-    while (read_bytes < bytes_to_read) {
-      long curr_read_bytes;
-      if (bytes_to_read - read_bytes > edge_unit_size * CHUNKSIZE) {
-        curr_read_bytes = read(fin, read_edge_buffer, edge_unit_size * CHUNKSIZE);
-      } else {
-        curr_read_bytes = read(fin, read_edge_buffer, bytes_to_read - read_bytes);
-      }
-      assert(curr_read_bytes>=0);
-      read_bytes += curr_read_bytes;
-      EdgeId curr_read_edges = curr_read_bytes / edge_unit_size;
+    rewind_edges();
+    EdgeId curr_read_edges;
+    while ((curr_read_edges = read_edges(read_edge_buffer)) > 0) {
       // #pragma omp parallel for
       for (EdgeId e_i=0;e_i<curr_read_edges;e_i++) {
         VertexId src = read_edge_buffer[e_i].src;
         VertexId dst = read_edge_buffer[e_i].dst;
         __sync_fetch_and_add(&out_degree[src], 1);
-        __sync_fetch_and_add(&out_degree[dst], 1);
+        if (mirror) {
+          __sync_fetch_and_add(&out_degree[dst], 1);
+        }
       }
     }
     MPI_Allreduce(MPI_IN_PLACE, out_degree, vertices, vid_t, MPI_SUM, MPI_COMM_WORLD);
@@ -435,7 +866,7 @@ public:
     // locality-aware chunking
     partition_offset = new VertexId [partitions + 1];
     partition_offset[0] = 0;
-    EdgeId remained_amount = edges * 2 + EdgeId(vertices) * alpha;
+    EdgeId remained_amount = edges * (mirror ? 2 : 1) + EdgeId(vertices) * alpha;
     for (int i=0;i<partitions;i++) {
       VertexId remained_partitions = partitions - i;
       EdgeId expected_chunk_size = remained_amount / remained_partitions;
@@ -525,7 +956,7 @@ public:
     for (VertexId v_i=partition_offset[partition_id];v_i<partition_offset[partition_id+1];v_i++) {
       filtered_out_degree[v_i] = out_degree[v_i];
     }
-    numa_free(out_degree, sizeof(VertexId) * vertices);
+    dealloc_vertex_array(out_degree);
     out_degree = filtered_out_degree;
     in_degree = out_degree;
 
@@ -535,6 +966,7 @@ public:
       send_buffer[i].resize(edge_unit_size * CHUNKSIZE);
     }
     EdgeUnit<EdgeData> * recv_buffer = new EdgeUnit<EdgeData> [CHUNKSIZE];
+    memory.account("loading buffers", -1, edge_unit_size * CHUNKSIZE * partitions + sizeof(EdgeUnit<EdgeData>) * CHUNKSIZE);
 
     // constructing symmetric edges
     EdgeId recv_outgoing_edges = 0;
@@ -544,8 +976,9 @@ public:
     outgoing_adj_bitmap = new Bitmap * [sockets];
     for (int s_i=0;s_i<sockets;s_i++) {
       outgoing_adj_bitmap[s_i] = new Bitmap (vertices);
+      account_bitmap(outgoing_adj_bitmap[s_i], "outgoing_adj_bitmap");
       outgoing_adj_bitmap[s_i]->clear();
-      outgoing_adj_index[s_i] = (EdgeId*)numa_alloc_onnode(sizeof(EdgeId) * (vertices+1), s_i);
+      outgoing_adj_index[s_i] = (EdgeId*)alloc_on_node("outgoing_adj_index", sizeof(EdgeId) * (vertices+1), s_i);
     }
     {
       std::thread recv_thread_dst([&](){
@@ -584,18 +1017,9 @@ public:
       for (int i=0;i<partitions;i++) {
         buffered_edges[i] = 0;
       }
-      assert(lseek(fin, read_offset, SEEK_SET)==read_offset);
-      read_bytes = 0;
-      while (read_bytes < bytes_to_read) {
-        long curr_read_bytes;
-        if (bytes_to_read - read_bytes > edge_unit_size * CHUNKSIZE) {
-          curr_read_bytes = read(fin, read_edge_buffer, edge_unit_size * CHUNKSIZE);
-        } else {
-          curr_read_bytes = read(fin, read_edge_buffer, bytes_to_read - read_bytes);
-        }
-        assert(curr_read_bytes>=0);
-        read_bytes += curr_read_bytes;
-        EdgeId curr_read_edges = curr_read_bytes / edge_unit_size;
+      rewind_edges();
+      EdgeId curr_read_edges;
+      while ((curr_read_edges = read_edges(read_edge_buffer)) > 0) {
         for (EdgeId e_i=0;e_i<curr_read_edges;e_i++) {
           VertexId dst = read_edge_buffer[e_i].dst;
           int i = get_partition_id(dst);
@@ -606,6 +1030,7 @@ public:
             buffered_edges[i] = 0;
           }
         }
+        if (!mirror) continue;
         for (EdgeId e_i=0;e_i<curr_read_edges;e_i++) {
           // std::swap(read_edge_buffer[e_i].src, read_edge_buffer[e_i].dst);
           VertexId tmp = read_edge_buffer[e_i].src;
@@ -633,6 +1058,8 @@ public:
         MPI_Send(&c, 1, MPI_CHAR, i, ShuffleGraph, MPI_COMM_WORLD);
       }
       recv_thread_dst.join();
+      // the next shuffle reuses the tag, so no rank may start it while another still expects this one
+      MPI_Barrier(MPI_COMM_WORLD);
       #ifdef PRINT_DEBUG_MESSAGES
       printf("machine(%d) got %lu symmetric edges\n", partition_id, recv_outgoing_edges);
       #endif
@@ -648,7 +1075,7 @@ public:
           compressed_outgoing_adj_vertices[s_i] += 1;
         }
       }
-      compressed_outgoing_adj_index[s_i] = (CompressedAdjIndexUnit*)numa_alloc_onnode( sizeof(CompressedAdjIndexUnit) * (compressed_outgoing_adj_vertices[s_i] + 1) , s_i );
+      compressed_outgoing_adj_index[s_i] = (CompressedAdjIndexUnit*)alloc_on_node("compressed_outgoing_adj_index", sizeof(CompressedAdjIndexUnit) * (compressed_outgoing_adj_vertices[s_i] + 1), s_i);
       compressed_outgoing_adj_index[s_i][0].index = 0;
       EdgeId last_e_i = 0;
       compressed_outgoing_adj_vertices[s_i] = 0;
@@ -669,7 +1096,7 @@ public:
       #ifdef PRINT_DEBUG_MESSAGES
       printf("part(%d) E_%d has %lu symmetric edges\n", partition_id, s_i, outgoing_edges[s_i]);
       #endif
-      outgoing_adj_list[s_i] = (AdjUnit<EdgeData>*)numa_alloc_onnode(unit_size * outgoing_edges[s_i], s_i);
+      outgoing_adj_list[s_i] = (AdjUnit<EdgeData>*)alloc_adj_list("outgoing_adj_list", unit_size * outgoing_edges[s_i], s_i);
     }
     {
       std::thread recv_thread_dst([&](){
@@ -707,18 +1134,9 @@ public:
       for (int i=0;i<partitions;i++) {
         buffered_edges[i] = 0;
       }
-      assert(lseek(fin, read_offset, SEEK_SET)==read_offset);
-      read_bytes = 0;
-      while (read_bytes < bytes_to_read) {
-        long curr_read_bytes;
-        if (bytes_to_read - read_bytes > edge_unit_size * CHUNKSIZE) {
-          curr_read_bytes = read(fin, read_edge_buffer, edge_unit_size * CHUNKSIZE);
-        } else {
-          curr_read_bytes = read(fin, read_edge_buffer, bytes_to_read - read_bytes);
-        }
-        assert(curr_read_bytes>=0);
-        read_bytes += curr_read_bytes;
-        EdgeId curr_read_edges = curr_read_bytes / edge_unit_size;
+      rewind_edges();
+      EdgeId curr_read_edges;
+      while ((curr_read_edges = read_edges(read_edge_buffer)) > 0) {
         for (EdgeId e_i=0;e_i<curr_read_edges;e_i++) {
           VertexId dst = read_edge_buffer[e_i].dst;
           int i = get_partition_id(dst);
@@ -729,6 +1147,7 @@ public:
             buffered_edges[i] = 0;
           }
         }
+        if (!mirror) continue;
         for (EdgeId e_i=0;e_i<curr_read_edges;e_i++) {
           // std::swap(read_edge_buffer[e_i].src, read_edge_buffer[e_i].dst);
           VertexId tmp = read_edge_buffer[e_i].src;
@@ -756,6 +1175,8 @@ public:
         MPI_Send(&c, 1, MPI_CHAR, i, ShuffleGraph, MPI_COMM_WORLD);
       }
       recv_thread_dst.join();
+      // the next shuffle reuses the tag, so no rank may start it while another still expects this one
+      MPI_Barrier(MPI_COMM_WORLD);
     }
     for (int s_i=0;s_i<sockets;s_i++) {
       for (VertexId p_v_i=0;p_v_i<compressed_outgoing_adj_vertices[s_i];p_v_i++) {
@@ -778,7 +1199,12 @@ public:
     delete [] send_buffer;
     delete [] read_edge_buffer;
     delete [] recv_buffer;
-    close(fin);
+    memory.account("loading buffers", -1, -(long)(edge_unit_size * CHUNKSIZE * partitions + sizeof(EdgeUnit<EdgeData>) * CHUNKSIZE * 2));
+
+    if (sort_adjacency) {
+      compact_outgoing_adjacency();
+      recount_degrees();
+    }
 
     tune_chunks();
     tuned_chunks_sparse = tuned_chunks_dense;
@@ -789,6 +1215,7 @@ public:
     if (partition_id==0) {
       printf("preprocessing cost: %.2lf (s)\n", prep_time);
     }
+    print_memory_report();
     #endif
   }
 
@@ -804,6 +1231,118 @@ public:
     std::swap(compressed_outgoing_adj_index, compressed_incoming_adj_index);
   }
 
+  // sort the outgoing lists (the threads of each socket share its lists), keep the first edge to each neighbour
+  // and, if drop_self_loops, none to the vertex itself; vertices left without edges leave the indices and bitmaps
+  void compact_outgoing_adjacency() {
+    std::vector<EdgeId> * kept = new std::vector<EdgeId> [sockets];
+    VertexId * cursor = new VertexId [sockets];
+    for (int s_i=0;s_i<sockets;s_i++) {
+      kept[s_i].resize(compressed_outgoing_adj_vertices[s_i]);
+      cursor[s_i] = 0;
+    }
+    #pragma omp parallel
+    {
+      int s_i = get_socket_id(omp_get_thread_num());
+      CompressedAdjIndexUnit * compressed_index = compressed_outgoing_adj_index[s_i];
+      while (true) {
+        VertexId begin_p_v_i = __sync_fetch_and_add(&cursor[s_i], 64);
+        if (begin_p_v_i >= compressed_outgoing_adj_vertices[s_i]) break;
+        VertexId end_p_v_i = std::min(begin_p_v_i + 64, compressed_outgoing_adj_vertices[s_i]);
+        for (VertexId p_v_i=begin_p_v_i;p_v_i<end_p_v_i;p_v_i++) {
+          VertexId v_i = compressed_index[p_v_i].vertex;
+          AdjUnit<EdgeData> * first = outgoing_adj_list[s_i] + compressed_index[p_v_i].index;
+          AdjUnit<EdgeData> * last = outgoing_adj_list[s_i] + compressed_index[p_v_i+1].index;
+          std::sort(first, last, adj_unit_less<EdgeData>);
+          last = std::unique(first, last, [](const AdjUnit<EdgeData> & a, const AdjUnit<EdgeData> & b) {
+            return a.neighbour == b.neighbour;
+          });
+          if (drop_self_loops) {
+            last = std::remove_if(first, last, [&](const AdjUnit<EdgeData> & a) {
+              return a.neighbour == v_i;
+            });
+          }
+          kept[s_i][p_v_i] = last - first;
+        }
+      }
+    }
+    for (int s_i=0;s_i<sockets;s_i++) {
+      CompressedAdjIndexUnit * compressed_index = compressed_outgoing_adj_index[s_i];
+      AdjUnit<EdgeData> * list = outgoing_adj_list[s_i];
+      VertexId adj_vertices = 0;
+      EdgeId adj_edges = 0;
+      EdgeId begin_e_i = compressed_index[0].index;
+      for (VertexId p_v_i=0;p_v_i<compressed_outgoing_adj_vertices[s_i];p_v_i++) {
+        // entries up to p_v_i+1 are rewritten below, so read the next vertex's start first
+        EdgeId next_begin_e_i = compressed_index[p_v_i+1].index;
+        VertexId v_i = compressed_index[p_v_i].vertex;
+        if (kept[s_i][p_v_i] > 0) {
+          memmove(list + adj_edges, list + begin_e_i, unit_size * kept[s_i][p_v_i]);
+          compressed_index[adj_vertices].vertex = v_i;
+          compressed_index[adj_vertices].index = adj_edges;
+          outgoing_adj_index[s_i][v_i] = adj_edges;
+          adj_edges += kept[s_i][p_v_i];
+          adj_vertices += 1;
+          compressed_index[adj_vertices].index = adj_edges;
+          outgoing_adj_index[s_i][v_i+1] = adj_edges;
+        } else {
+          outgoing_adj_bitmap[s_i]->clear_bit(v_i);
+        }
+        begin_e_i = next_begin_e_i;
+      }
+      #ifdef PRINT_DEBUG_MESSAGES
+      printf("part(%d) E_%d keeps %lu of %lu edges after sorting\n", partition_id, s_i, adj_edges, outgoing_edges[s_i]);
+      #endif
+      compressed_outgoing_adj_vertices[s_i] = adj_vertices;
+      outgoing_edges[s_i] = adj_edges;
+      memory.shrink(list, unit_size * adj_edges);
+    }
+    delete [] kept;
+    delete [] cursor;
+  }
+
+  // degrees of owned vertices and the edge count after compaction: the local outgoing lists hold every edge into
+  // an owned vertex and the local incoming lists every edge out of one
+  void recount_degrees() {
+    for (VertexId v_i=partition_offset[partition_id];v_i<partition_offset[partition_id+1];v_i++) {
+      in_degree[v_i] = 0;
+      out_degree[v_i] = 0;
+    }
+    EdgeId self_loops = 0;
+    for (int s_i=0;s_i<sockets;s_i++) {
+      #pragma omp parallel for schedule(dynamic, 64) reduction(+:self_loops)
+      for (VertexId p_v_i=0;p_v_i<compressed_outgoing_adj_vertices[s_i];p_v_i++) {
+        VertexId src = compressed_outgoing_adj_index[s_i][p_v_i].vertex;
+        for (EdgeId e_i=compressed_outgoing_adj_index[s_i][p_v_i].index;e_i<compressed_outgoing_adj_index[s_i][p_v_i+1].index;e_i++) {
+          VertexId dst = outgoing_adj_list[s_i][e_i].neighbour;
+          __sync_fetch_and_add(&in_degree[dst], 1);
+          if (dst==src) {
+            self_loops += 1;
+          }
+        }
+      }
+    }
+    EdgeId local_edges = 0;
+    for (int s_i=0;s_i<sockets;s_i++) {
+      local_edges += outgoing_edges[s_i];
+    }
+    if (!symmetric) {
+      for (int s_i=0;s_i<sockets;s_i++) {
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (VertexId p_v_i=0;p_v_i<compressed_incoming_adj_vertices[s_i];p_v_i++) {
+          for (EdgeId e_i=compressed_incoming_adj_index[s_i][p_v_i].index;e_i<compressed_incoming_adj_index[s_i][p_v_i+1].index;e_i++) {
+            __sync_fetch_and_add(&out_degree[incoming_adj_list[s_i][e_i].neighbour], 1);
+          }
+        }
+      }
+    }
+    MPI_Allreduce(&local_edges, &edges, 1, get_mpi_data_type<EdgeId>(), MPI_SUM, MPI_COMM_WORLD);
+    if (symmetric) {
+      // both directions of an edge are stored (possibly on different ranks), but a self-loop only once
+      MPI_Allreduce(MPI_IN_PLACE, &self_loops, 1, get_mpi_data_type<EdgeId>(), MPI_SUM, MPI_COMM_WORLD);
+      edges = (edges + self_loops) / 2;
+    }
+  }
+
   // load a directed graph from path
   void load_directed(std::string path, VertexId vertices) {
     double prep_time = 0;
@@ -832,6 +1371,7 @@ public:
     long read_bytes;
     int fin = open(path.c_str(), O_RDONLY);
     EdgeUnit<EdgeData> * read_edge_buffer = new EdgeUnit<EdgeData> [CHUNKSIZE];
+    memory.account("loading buffers", -1, sizeof(EdgeUnit<EdgeData>) * CHUNKSIZE);
 
     out_degree = alloc_interleaved_vertex_array<VertexId>();
     for (VertexId v_i=0;v_i<vertices;v_i++) {
@@ -964,7 +1504,7 @@ public:
     for (VertexId v_i=partition_offset[partition_id];v_i<partition_offset[partition_id+1];v_i++) {
       filtered_out_degree[v_i] = out_degree[v_i];
     }
-    numa_free(out_degree, sizeof(VertexId) * vertices);
+    dealloc_vertex_array(out_degree);
     out_degree = filtered_out_degree;
     in_degree = alloc_vertex_array<VertexId>();
     for (VertexId v_i=partition_offset[partition_id];v_i<partition_offset[partition_id+1];v_i++) {
@@ -977,6 +1517,7 @@ public:
       send_buffer[i].resize(edge_unit_size * CHUNKSIZE);
     }
     EdgeUnit<EdgeData> * recv_buffer = new EdgeUnit<EdgeData> [CHUNKSIZE];
+    memory.account("loading buffers", -1, edge_unit_size * CHUNKSIZE * partitions + sizeof(EdgeUnit<EdgeData>) * CHUNKSIZE);
 
     EdgeId recv_outgoing_edges = 0;
     outgoing_edges = new EdgeId [sockets];
@@ -985,8 +1526,9 @@ public:
     outgoing_adj_bitmap = new Bitmap * [sockets];
     for (int s_i=0;s_i<sockets;s_i++) {
       outgoing_adj_bitmap[s_i] = new Bitmap (vertices);
+      account_bitmap(outgoing_adj_bitmap[s_i], "outgoing_adj_bitmap");
       outgoing_adj_bitmap[s_i]->clear();
-      outgoing_adj_index[s_i] = (EdgeId*)numa_alloc_onnode(sizeof(EdgeId) * (vertices+1), s_i);
+      outgoing_adj_index[s_i] = (EdgeId*)alloc_on_node("outgoing_adj_index", sizeof(EdgeId) * (vertices+1), s_i);
     }
     {
       std::thread recv_thread_dst([&](){
@@ -1059,6 +1601,8 @@ public:
         MPI_Send(&c, 1, MPI_CHAR, i, ShuffleGraph, MPI_COMM_WORLD);
       }
       recv_thread_dst.join();
+      // the next shuffle reuses the tag, so no rank may start it while another still expects this one
+      MPI_Barrier(MPI_COMM_WORLD);
       #ifdef PRINT_DEBUG_MESSAGES
       printf("machine(%d) got %lu sparse mode edges\n", partition_id, recv_outgoing_edges);
       #endif
@@ -1074,7 +1618,7 @@ public:
           compressed_outgoing_adj_vertices[s_i] += 1;
         }
       }
-      compressed_outgoing_adj_index[s_i] = (CompressedAdjIndexUnit*)numa_alloc_onnode( sizeof(CompressedAdjIndexUnit) * (compressed_outgoing_adj_vertices[s_i] + 1) , s_i );
+      compressed_outgoing_adj_index[s_i] = (CompressedAdjIndexUnit*)alloc_on_node("compressed_outgoing_adj_index", sizeof(CompressedAdjIndexUnit) * (compressed_outgoing_adj_vertices[s_i] + 1), s_i);
       compressed_outgoing_adj_index[s_i][0].index = 0;
       EdgeId last_e_i = 0;
       compressed_outgoing_adj_vertices[s_i] = 0;
@@ -1095,7 +1639,7 @@ public:
       #ifdef PRINT_DEBUG_MESSAGES
       printf("part(%d) E_%d has %lu sparse mode edges\n", partition_id, s_i, outgoing_edges[s_i]);
       #endif
-      outgoing_adj_list[s_i] = (AdjUnit<EdgeData>*)numa_alloc_onnode(unit_size * outgoing_edges[s_i], s_i);
+      outgoing_adj_list[s_i] = (AdjUnit<EdgeData>*)alloc_adj_list("outgoing_adj_list", unit_size * outgoing_edges[s_i], s_i);
     }
     {
       std::thread recv_thread_dst([&](){
@@ -1166,6 +1710,8 @@ public:
         MPI_Send(&c, 1, MPI_CHAR, i, ShuffleGraph, MPI_COMM_WORLD);
       }
       recv_thread_dst.join();
+      // the next shuffle reuses the tag, so no rank may start it while another still expects this one
+      MPI_Barrier(MPI_COMM_WORLD);
     }
     for (int s_i=0;s_i<sockets;s_i++) {
       for (VertexId p_v_i=0;p_v_i<compressed_outgoing_adj_vertices[s_i];p_v_i++) {
@@ -1183,8 +1729,9 @@ public:
     incoming_adj_bitmap = new Bitmap * [sockets];
     for (int s_i=0;s_i<sockets;s_i++) {
       incoming_adj_bitmap[s_i] = new Bitmap (vertices);
+      account_bitmap(incoming_adj_bitmap[s_i], "incoming_adj_bitmap");
       incoming_adj_bitmap[s_i]->clear();
-      incoming_adj_index[s_i] = (EdgeId*)numa_alloc_onnode(sizeof(EdgeId) * (vertices+1), s_i);
+      incoming_adj_index[s_i] = (EdgeId*)alloc_on_node("incoming_adj_index", sizeof(EdgeId) * (vertices+1), s_i);
     }
     {
       std::thread recv_thread_src([&](){
@@ -1256,6 +1803,8 @@ public:
         MPI_Send(&c, 1, MPI_CHAR, i, ShuffleGraph, MPI_COMM_WORLD);
       }
       recv_thread_src.join();
+      // the next shuffle reuses the tag, so no rank may start it while another still expects this one
+      MPI_Barrier(MPI_COMM_WORLD);
       #ifdef PRINT_DEBUG_MESSAGES
       printf("machine(%d) got %lu dense mode edges\n", partition_id, recv_incoming_edges);
       #endif
@@ -1271,7 +1820,7 @@ public:
           compressed_incoming_adj_vertices[s_i] += 1;
         }
       }
-      compressed_incoming_adj_index[s_i] = (CompressedAdjIndexUnit*)numa_alloc_onnode( sizeof(CompressedAdjIndexUnit) * (compressed_incoming_adj_vertices[s_i] + 1) , s_i );
+      compressed_incoming_adj_index[s_i] = (CompressedAdjIndexUnit*)alloc_on_node("compressed_incoming_adj_index", sizeof(CompressedAdjIndexUnit) * (compressed_incoming_adj_vertices[s_i] + 1), s_i);
       compressed_incoming_adj_index[s_i][0].index = 0;
       EdgeId last_e_i = 0;
       compressed_incoming_adj_vertices[s_i] = 0;
@@ -1292,7 +1841,7 @@ public:
       #ifdef PRINT_DEBUG_MESSAGES
       printf("part(%d) E_%d has %lu dense mode edges\n", partition_id, s_i, incoming_edges[s_i]);
       #endif
-      incoming_adj_list[s_i] = (AdjUnit<EdgeData>*)numa_alloc_onnode(unit_size * incoming_edges[s_i], s_i);
+      incoming_adj_list[s_i] = (AdjUnit<EdgeData>*)alloc_adj_list("incoming_adj_list", unit_size * incoming_edges[s_i], s_i);
     }
     {
       std::thread recv_thread_src([&](){
@@ -1363,6 +1912,8 @@ public:
         MPI_Send(&c, 1, MPI_CHAR, i, ShuffleGraph, MPI_COMM_WORLD);
       }
       recv_thread_src.join();
+      // the next shuffle reuses the tag, so no rank may start it while another still expects this one
+      MPI_Barrier(MPI_COMM_WORLD);
     }
     for (int s_i=0;s_i<sockets;s_i++) {
       for (VertexId p_v_i=0;p_v_i<compressed_incoming_adj_vertices[s_i];p_v_i++) {
@@ -1377,8 +1928,17 @@ public:
     delete [] send_buffer;
     delete [] read_edge_buffer;
     delete [] recv_buffer;
+    memory.account("loading buffers", -1, -(long)(edge_unit_size * CHUNKSIZE * partitions + sizeof(EdgeUnit<EdgeData>) * CHUNKSIZE * 2));
     close(fin);
 
+    if (sort_adjacency) {
+      compact_outgoing_adjacency();
+      transpose();
+      compact_outgoing_adjacency();
+      transpose();
+      recount_degrees();
+    }
+
     transpose();
     tune_chunks();
     transpose();
@@ -1390,6 +1950,7 @@ public:
     if (partition_id==0) {
       printf("preprocessing cost: %.2lf (s)\n", prep_time);
     }
+    print_memory_report();
     #endif
   }
 
@@ -1458,13 +2019,42 @@ public:
     }
   }
 
-  // process vertices
-  template<typename R>
+  // combine the partial results of all partitions; a single partition needs no communication
+  template<typename R, typename Op>
+  R reduce_partitions(R reducer) {
+    if (partitions==1) {
+      return reducer;
+    }
+    R global_reducer;
+    MPI_Allreduce(&reducer, &global_reducer, 1, get_mpi_data_type<R>(), get_mpi_op<R, Op>(), MPI_COMM_WORLD);
+    return global_reducer;
+  }
+
+  // process vertices; the results of process are folded with Op (a sum by default)
+  template<typename R, typename Op = SumReduction<R>>
   R process_vertices(std::function<R(VertexId)> process, Bitmap * active) {
     double stream_time = 0;
     stream_time -= MPI_Wtime();
 
-    R reducer = 0;
+    R reducer = Op::identity();
+    if (active->has_queue()) {
+      // a sparse subset: visit its queued vertices instead of scanning every word of the partition
+      size_t queue_size = active->queue_size;
+      #pragma omp parallel
+      {
+        R local_reducer = Op::identity();
+        #pragma omp for
+        for (size_t q_i=0;q_i<queue_size;q_i++) {
+          VertexId v_i = active->queue[q_i];
+          if (v_i >= partition_offset[partition_id] && v_i < partition_offset[partition_id+1]) {
+            Op::combine(local_reducer, process(v_i));
+          }
+        }
+        #pragma omp critical
+        Op::combine(reducer, local_reducer);
+      }
+      return reduce_partitions<R, Op>(reducer);
+    }
     size_t basic_chunk = 64;
     for (int t_i=0;t_i<threads;t_i++) {
       int s_i = get_socket_id(t_i);
@@ -1477,20 +2067,17 @@ public:
       }
       thread_state[t_i]->status = WORKING;
     }
-    #pragma omp parallel reduction(+:reducer)
+    #pragma omp parallel
     {
-      R local_reducer = 0;
+      R local_reducer = Op::identity();
       int thread_id = omp_get_thread_num();
       while (true) {
         VertexId v_i = __sync_fetch_and_add(&thread_state[thread_id]->curr, basic_chunk);
         if (v_i >= thread_state[thread_id]->end) break;
         unsigned long word = active->data[WORD_OFFSET(v_i)];
         while (word != 0) {
-          if (word & 1) {
-            local_reducer += process(v_i);
-          }
-          v_i++;
-          word = word >> 1;
+          Op::combine(local_reducer, process(v_i + __builtin_ctzl(word)));
+          word &= word - 1;
         }
       }
       thread_state[thread_id]->status = STEALING;
@@ -1501,19 +2088,15 @@ public:
           if (v_i >= thread_state[t_i]->end) continue;
           unsigned long word = active->data[WORD_OFFSET(v_i)];
           while (word != 0) {
-            if (word & 1) {
-              local_reducer += process(v_i);
-            }
-            v_i++;
-            word = word >> 1;
+            Op::combine(local_reducer, process(v_i + __builtin_ctzl(word)));
+            word &= word - 1;
           }
         }
       }
-      reducer += local_reducer;
+      #pragma omp critical
+      Op::combine(reducer, local_reducer);
     }
-    R global_reducer;
-    MPI_Datatype dt = get_mpi_data_type<R>();
-    MPI_Allreduce(&reducer, &global_reducer, 1, dt, MPI_SUM, MPI_COMM_WORLD);
+    R global_reducer = reduce_partitions<R, Op>(reducer);
     stream_time += MPI_Wtime();
     #ifdef PRINT_DEBUG_MESSAGES
     if (partition_id==0) {
@@ -1523,12 +2106,40 @@ public:
     return global_reducer;
   }
 
-  template<typename M>
   void flush_local_send_buffer(int t_i) {
+    if (list_messages) {
+      flush_local_list_buffer(t_i);
+      return;
+    }
     int s_i = get_socket_id(t_i);
     int pos = __sync_fetch_and_add(&send_buffer[current_send_part_id][s_i]->count, local_send_buffer[t_i]->count);
-    memcpy(send_buffer[current_send_part_id][s_i]->data + sizeof(MsgUnit<M>) * pos, local_send_buffer[t_i]->data, sizeof(MsgUnit<M>) * local_send_buffer[t_i]->count);
+    memcpy(send_buffer[current_send_part_id][s_i]->data + message_unit_bytes * pos, local_send_buffer[t_i]->data, message_unit_bytes * local_send_buffer[t_i]->count);
+    local_send_buffer[t_i]->count = 0;
+  }
+
+  // the payloads of a thread's list messages are appended to the socket's payload buffer, which may have to grow,
+  // so list flushes take the socket's lock and rebase the offsets of their units
+  void flush_local_list_buffer(int t_i) {
+    int s_i = get_socket_id(t_i);
+    MessageBuffer * units = send_buffer[current_send_part_id][s_i];
+    MessageBuffer * payload = send_payload_buffer[current_send_part_id][s_i];
+    MsgSpan * local_units = (MsgSpan *)local_send_buffer[t_i]->data;
+    std::lock_guard<std::mutex> guard(payload_lock[s_i]);
+    size_t offset = payload->count;
+    size_t bytes = local_payload_buffer[t_i]->count;
+    assert(offset + bytes <= (size_t)INT_MAX);
+    if (offset + bytes > payload->capacity) {
+      resize_message_buffer(payload, std::max(offset + bytes, payload->capacity * 2), "send_payload_buffer");
+    }
+    memcpy(payload->data + offset, local_payload_buffer[t_i]->data, bytes);
+    payload->count += bytes;
+    for (int u_i=0;u_i<local_send_buffer[t_i]->count;u_i++) {
+      local_units[u_i].offset += offset;
+    }
+    memcpy(units->data + sizeof(MsgSpan) * units->count, local_units, sizeof(MsgSpan) * local_send_buffer[t_i]->count);
+    units->count += local_send_buffer[t_i]->count;
     local_send_buffer[t_i]->count = 0;
+    local_payload_buffer[t_i]->count = 0;
   }
 
   // emit a message to a vertex's master (dense) / mirror (sparse)
@@ -1540,21 +2151,207 @@ public:
     buffer[local_send_buffer[t_i]->count].msg_data = msg;
     local_send_buffer[t_i]->count += 1;
     if (local_send_buffer[t_i]->count==local_send_buffer_limit) {
-      flush_local_send_buffer<M>(t_i);
+      flush_local_send_buffer(t_i);
     }
   }
 
+  // emit the width elements at msg (width as given to process_edges_array)
+  template<typename T>
+  void emit_array(VertexId vtx, const T * msg) {
+    int t_i = omp_get_thread_num();
+    char * unit = local_send_buffer[t_i]->data + message_unit_bytes * local_send_buffer[t_i]->count;
+    memcpy(unit, &vtx, sizeof(VertexId));
+    memcpy(unit + sizeof(VertexId), msg, message_array_bytes);
+    local_send_buffer[t_i]->count += 1;
+    if (local_send_buffer[t_i]->count==local_send_buffer_limit) {
+      flush_local_send_buffer(t_i);
+    }
+  }
+
+  // emit the length elements at msg (within process_edges_list)
+  template<typename T>
+  void emit_list(VertexId vtx, const T * msg, size_t length) {
+    int t_i = omp_get_thread_num();
+    MessageBuffer * payload = local_payload_buffer[t_i];
+    // payloads stay aligned to 8 bytes, so that the slots can read them in place
+    size_t bytes = (sizeof(T) * length + 7) / 8 * 8;
+    if (payload->count + bytes > payload->capacity) {
+      resize_message_buffer(payload, std::max(payload->count + bytes, payload->capacity * 2), "local_payload_buffer");
+    }
+    MsgSpan * units = (MsgSpan *)local_send_buffer[t_i]->data;
+    units[local_send_buffer[t_i]->count] = MsgSpan{vtx, (size_t)payload->count, length};
+    memcpy(payload->data + payload->count, msg, sizeof(T) * length);
+    payload->count += bytes;
+    local_send_buffer[t_i]->count += 1;
+    if (local_send_buffer[t_i]->count==local_send_buffer_limit) {
+      flush_local_send_buffer(t_i);
+    }
+  }
+
+  // send socket s_i's buffer of the messages for partition part (and their payloads) to partition i
+  void send_messages(int part, int s_i, int i) {
+    MPI_Send(send_buffer[part][s_i]->data, message_unit_bytes * send_buffer[part][s_i]->count, MPI_CHAR, i, PassMessage, MPI_COMM_WORLD);
+    if (list_messages) {
+      MPI_Send(send_payload_buffer[part][s_i]->data, send_payload_buffer[part][s_i]->count, MPI_CHAR, i, PassMessage, MPI_COMM_WORLD);
+    }
+  }
+
+  // receive the buffer that socket s_i of partition i sends (and its payloads)
+  void recv_messages(int i, int s_i) {
+    MPI_Status recv_status;
+    MPI_Probe(i, PassMessage, MPI_COMM_WORLD, &recv_status);
+    MPI_Get_count(&recv_status, MPI_CHAR, &recv_buffer[i][s_i]->count);
+    MPI_Recv(recv_buffer[i][s_i]->data, recv_buffer[i][s_i]->count, MPI_CHAR, i, PassMessage, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    recv_buffer[i][s_i]->count /= message_unit_bytes;
+    if (list_messages) {
+      MessageBuffer * payload = recv_payload_buffer[i][s_i];
+      MPI_Probe(i, PassMessage, MPI_COMM_WORLD, &recv_status);
+      MPI_Get_count(&recv_status, MPI_CHAR, &payload->count);
+      resize_message_buffer(payload, payload->count, "recv_payload_buffer");
+      MPI_Recv(payload->data, payload->count, MPI_CHAR, i, PassMessage, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    }
+  }
+
+  // bring the remote slices of a dense_selective bitmap up to date; ranks exchange the runs of owned words changed since
+  // the last sync, or their whole slices if the bitmap was reset or the runs would not be much smaller
+  void sync_dense_selective(Bitmap * bitmap) {
+    bitmap->track_dirty();
+    size_t begin_word = WORD_OFFSET(partition_offset[partition_id]);
+    size_t end_word = WORD_OFFSET(partition_offset[partition_id+1] + 63);
+    // encoded as (first word, number of words, words...)
+    std::vector<unsigned long> runs;
+    if (!bitmap->all_dirty) {
+      size_t w_i = begin_word;
+      while (w_i < end_word) {
+        if (bitmap->dirty[WORD_OFFSET(w_i)]==0) {
+          w_i = (WORD_OFFSET(w_i) + 1) << 6;
+          continue;
+        }
+        if (!bitmap->word_dirty(w_i)) {
+          w_i++;
+          continue;
+        }
+        size_t run_end = w_i;
+        while (run_end < end_word && bitmap->word_dirty(run_end)) {
+          run_end++;
+        }
+        runs.push_back(w_i);
+        runs.push_back(run_end - w_i);
+        runs.insert(runs.end(), bitmap->data + w_i, bitmap->data + run_end);
+        w_i = run_end;
+      }
+    }
+    int run_words = bitmap->all_dirty ? -1 : runs.size();
+    std::vector<int> counts(partitions);
+    std::vector<int> displs(partitions);
+    MPI_Allgather(&run_words, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    bool send_slices = false;
+    size_t total_run_words = 0;
+    for (int i=0;i<partitions;i++) {
+      if (counts[i] < 0) {
+        send_slices = true;
+      }
+      total_run_words += counts[i];
+    }
+    if (send_slices || total_run_words * 2 > WORD_OFFSET(vertices)) {
+      for (int i=0;i<partitions;i++) {
+        displs[i] = WORD_OFFSET(partition_offset[i]);
+        counts[i] = WORD_OFFSET(partition_offset[i+1] + 63) - displs[i];
+      }
+      MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, bitmap->data, counts.data(), displs.data(), MPI_UNSIGNED_LONG, MPI_COMM_WORLD);
+    } else {
+      for (int i=0;i<partitions;i++) {
+        displs[i] = i==0 ? 0 : displs[i-1] + counts[i-1];
+      }
+      std::vector<unsigned long> all_runs(total_run_words);
+      MPI_Allgatherv(runs.data(), runs.size(), MPI_UNSIGNED_LONG, all_runs.data(), counts.data(), displs.data(), MPI_UNSIGNED_LONG, MPI_COMM_WORLD);
+      for (int i=0;i<partitions;i++) {
+        if (i==partition_id) continue;
+        size_t r_i = displs[i];
+        while (r_i < (size_t)(displs[i] + counts[i])) {
+          size_t first_word = all_runs[r_i];
+          size_t run_length = all_runs[r_i+1];
+          memcpy(bitmap->data + first_word, all_runs.data() + r_i + 2, sizeof(unsigned long) * run_length);
+          r_i += 2 + run_length;
+        }
+      }
+    }
+    bitmap->drop_queue();
+    bitmap->reset_dirty();
+  }
+
   // process edges
-  template<typename R, typename M>
+  template<typename R, typename M, typename Op = SumReduction<R>>
   R process_edges(std::function<void(VertexId)> sparse_signal, std::function<R(VertexId, M, VertexAdjList<EdgeData>)> sparse_slot, std::function<void(VertexId, VertexAdjList<EdgeData>)> dense_signal, std::function<R(VertexId, M)> dense_slot, Bitmap * active, Bitmap * dense_selective = nullptr) {
+    return process_message_units<R, Op>(sizeof(MsgUnit<M>), false,
+      sparse_signal,
+      [&](VertexId src, const char * unit, const char * payload, VertexAdjList<EdgeData> outgoing_adj) {
+        return sparse_slot(src, ((const MsgUnit<M> *)unit)->msg_data, outgoing_adj);
+      },
+      dense_signal,
+      [&](VertexId dst, const char * unit, const char * payload) {
+        return dense_slot(dst, ((const MsgUnit<M> *)unit)->msg_data);
+      },
+      active, dense_selective
+    );
+  }
+
+  // process edges with messages of width elements of T, fixed for the call; signals send them with emit_array,
+  // and the slots read them in place from the message buffers
+  template<typename R, typename T, typename Op = SumReduction<R>>
+  R process_edges_array(size_t width, std::function<void(VertexId)> sparse_signal, std::function<R(VertexId, const T *, VertexAdjList<EdgeData>)> sparse_slot, std::function<void(VertexId, VertexAdjList<EdgeData>)> dense_signal, std::function<R(VertexId, const T *)> dense_slot, Bitmap * active, Bitmap * dense_selective = nullptr) {
+    static_assert(alignof(T) <= alignof(VertexId), "array messages are aligned to VertexId");
+    // units are padded to whole VertexIds, so that every message stays aligned
+    message_array_bytes = sizeof(T) * width;
+    size_t unit_bytes = (sizeof(VertexId) + message_array_bytes + sizeof(VertexId) - 1) / sizeof(VertexId) * sizeof(VertexId);
+    return process_message_units<R, Op>(unit_bytes, false,
+      sparse_signal,
+      [&](VertexId src, const char * unit, const char * payload, VertexAdjList<EdgeData> outgoing_adj) {
+        return sparse_slot(src, (const T *)(unit + sizeof(VertexId)), outgoing_adj);
+      },
+      dense_signal,
+      [&](VertexId dst, const char * unit, const char * payload) {
+        return dense_slot(dst, (const T *)(unit + sizeof(VertexId)));
+      },
+      active, dense_selective
+    );
+  }
+
+  // process edges with messages of any number of elements of T; signals send them with emit_list, and the slots
+  // read them in place from the payload buffers, indexed by a fixed-size MsgSpan per message
+  template<typename R, typename T, typename Op = SumReduction<R>>
+  R process_edges_list(std::function<void(VertexId)> sparse_signal, std::function<R(VertexId, const T *, size_t, VertexAdjList<EdgeData>)> sparse_slot, std::function<void(VertexId, VertexAdjList<EdgeData>)> dense_signal, std::function<R(VertexId, const T *, size_t)> dense_slot, Bitmap * active, Bitmap * dense_selective = nullptr) {
+    static_assert(alignof(T) <= 8, "list messages are aligned to 8 bytes");
+    return process_message_units<R, Op>(sizeof(MsgSpan), true,
+      sparse_signal,
+      [&](VertexId src, const char * unit, const char * payload, VertexAdjList<EdgeData> outgoing_adj) {
+        const MsgSpan * span = (const MsgSpan *)unit;
+        return sparse_slot(src, (const T *)(payload + span->offset), span->length, outgoing_adj);
+      },
+      dense_signal,
+      [&](VertexId dst, const char * unit, const char * payload) {
+        const MsgSpan * span = (const MsgSpan *)unit;
+        return dense_slot(dst, (const T *)(payload + span->offset), span->length);
+      },
+      active, dense_selective
+    );
+  }
+
+  // the engine behind process_edges*: messages are units of unit_bytes that start with the target vertex, followed by
+  // payload buffers if list is set; the slots get each unit (and the payload buffer it refers to) in place
+  template<typename R, typename Op, typename SparseSlot, typename DenseSlot>
+  R process_message_units(size_t unit_bytes, bool list, std::function<void(VertexId)> sparse_signal, SparseSlot sparse_slot, std::function<void(VertexId, VertexAdjList<EdgeData>)> dense_signal, DenseSlot dense_slot, Bitmap * active, Bitmap * dense_selective) {
     double stream_time = 0;
     stream_time -= MPI_Wtime();
 
+    message_unit_bytes = unit_bytes;
+    list_messages = list;
     for (int t_i=0;t_i<threads;t_i++) {
-      local_send_buffer[t_i]->resize( sizeof(MsgUnit<M>) * local_send_buffer_limit );
+      resize_message_buffer(local_send_buffer[t_i], unit_bytes * local_send_buffer_limit, "local_send_buffer");
       local_send_buffer[t_i]->count = 0;
+      local_payload_buffer[t_i]->count = 0;
     }
-    R reducer = 0;
+    R reducer = Op::identity();
     EdgeId active_edges = process_vertices<EdgeId>(
       [&](VertexId vtx){
         return (EdgeId)out_degree[vtx];
@@ -1565,19 +2362,23 @@ public:
     if (sparse) {
       for (int i=0;i<partitions;i++) {
         for (int s_i=0;s_i<sockets;s_i++) {
-          recv_buffer[i][s_i]->resize( sizeof(MsgUnit<M>) * (partition_offset[i+1] - partition_offset[i]) * sockets );
-          send_buffer[i][s_i]->resize( sizeof(MsgUnit<M>) * owned_vertices * sockets );
+          resize_message_buffer(recv_buffer[i][s_i], unit_bytes * (partition_offset[i+1] - partition_offset[i]) * sockets, "recv_buffer");
+          resize_message_buffer(send_buffer[i][s_i], unit_bytes * owned_vertices * sockets, "send_buffer");
           send_buffer[i][s_i]->count = 0;
           recv_buffer[i][s_i]->count = 0;
+          send_payload_buffer[i][s_i]->count = 0;
+          recv_payload_buffer[i][s_i]->count = 0;
         }
       }
     } else {
       for (int i=0;i<partitions;i++) {
         for (int s_i=0;s_i<sockets;s_i++) {
-          recv_buffer[i][s_i]->resize( sizeof(MsgUnit<M>) * owned_vertices * sockets );
-          send_buffer[i][s_i]->resize( sizeof(MsgUnit<M>) * (partition_offset[i+1] - partition_offset[i]) * sockets );
+          resize_message_buffer(recv_buffer[i][s_i], unit_bytes * owned_vertices * sockets, "recv_buffer");
+          resize_message_buffer(send_buffer[i][s_i], unit_bytes * (partition_offset[i+1] - partition_offset[i]) * sockets, "send_buffer");
           send_buffer[i][s_i]->count = 0;
           recv_buffer[i][s_i]->count = 0;
+          send_payload_buffer[i][s_i]->count = 0;
+          recv_payload_buffer[i][s_i]->count = 0;
         }
       }
     }
@@ -1593,50 +2394,58 @@ public:
       std::mutex recv_queue_mutex;
 
       current_send_part_id = partition_id;
-      #pragma omp parallel for
-      for (VertexId begin_v_i=partition_offset[partition_id];begin_v_i<partition_offset[partition_id+1];begin_v_i+=basic_chunk) {
-        VertexId v_i = begin_v_i;
-        unsigned long word = active->data[WORD_OFFSET(v_i)];
-        while (word != 0) {
-          if (word & 1) {
+      if (active->has_queue()) {
+        size_t queue_size = active->queue_size;
+        #pragma omp parallel for
+        for (size_t q_i=0;q_i<queue_size;q_i++) {
+          VertexId v_i = active->queue[q_i];
+          if (v_i >= partition_offset[partition_id] && v_i < partition_offset[partition_id+1]) {
             sparse_signal(v_i);
           }
-          v_i++;
-          word = word >> 1;
+        }
+      } else {
+        #pragma omp parallel for
+        for (VertexId begin_v_i=partition_offset[partition_id];begin_v_i<partition_offset[partition_id+1];begin_v_i+=basic_chunk) {
+          unsigned long word = active->data[WORD_OFFSET(begin_v_i)];
+          while (word != 0) {
+            sparse_signal(begin_v_i + __builtin_ctzl(word));
+            word &= word - 1;
+          }
         }
       }
       #pragma omp parallel for
       for (int t_i=0;t_i<threads;t_i++) {
-        flush_local_send_buffer<M>(t_i);
+        flush_local_send_buffer(t_i);
       }
       recv_queue[recv_queue_size] = partition_id;
       recv_queue_mutex.lock();
       recv_queue_size += 1;
       recv_queue_mutex.unlock();
-      std::thread send_thread([&](){
-        for (int step=1;step<partitions;step++) {
-          int i = (partition_id - step + partitions) % partitions;
-          for (int s_i=0;s_i<sockets;s_i++) {
-            MPI_Send(send_buffer[partition_id][s_i]->data, sizeof(MsgUnit<M>) * send_buffer[partition_id][s_i]->count, MPI_CHAR, i, PassMessage, MPI_COMM_WORLD);
+      // a single partition has nothing to exchange, so no communication threads are started
+      std::thread send_thread;
+      std::thread recv_thread;
+      if (partitions > 1) {
+        send_thread = std::thread([&](){
+          for (int step=1;step<partitions;step++) {
+            int i = (partition_id - step + partitions) % partitions;
+            for (int s_i=0;s_i<sockets;s_i++) {
+              send_messages(partition_id, s_i, i);
+            }
           }
-        }
-      });
-      std::thread recv_thread([&](){
-        for (int step=1;step<partitions;step++) {
-          int i = (partition_id + step) % partitions;
-          for (int s_i=0;s_i<sockets;s_i++) {
-            MPI_Status recv_status;
-            MPI_Probe(i, PassMessage, MPI_COMM_WORLD, &recv_status);
-            MPI_Get_count(&recv_status, MPI_CHAR, &recv_buffer[i][s_i]->count);
-            MPI_Recv(recv_buffer[i][s_i]->data, recv_buffer[i][s_i]->count, MPI_CHAR, i, PassMessage, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            recv_buffer[i][s_i]->count /= sizeof(MsgUnit<M>);
+        });
+        recv_thread = std::thread([&](){
+          for (int step=1;step<partitions;step++) {
+            int i = (partition_id + step) % partitions;
+            for (int s_i=0;s_i<sockets;s_i++) {
+              recv_messages(i, s_i);
+            }
+            recv_queue[recv_queue_size] = i;
+            recv_queue_mutex.lock();
+            recv_queue_size += 1;
+            recv_queue_mutex.unlock();
           }
-          recv_queue[recv_queue_size] = i;
-          recv_queue_mutex.lock();
-          recv_queue_size += 1;
-          recv_queue_mutex.unlock();
-        }
-      });
+        });
+      }
       for (int step=0;step<partitions;step++) {
         while (true) {
           recv_queue_mutex.lock();
@@ -1647,13 +2456,17 @@ public:
         }
         int i = recv_queue[step];
         MessageBuffer ** used_buffer;
+        MessageBuffer ** used_payload;
         if (i==partition_id) {
           used_buffer = send_buffer[i];
+          used_payload = send_payload_buffer[i];
         } else {
           used_buffer = recv_buffer[i];
+          used_payload = recv_payload_buffer[i];
         }
         for (int s_i=0;s_i<sockets;s_i++) {
-          MsgUnit<M> * buffer = (MsgUnit<M> *)used_buffer[s_i]->data;
+          const char * buffer = used_buffer[s_i]->data;
+          const char * payload = used_payload[s_i]->data;
           size_t buffer_size = used_buffer[s_i]->count;
           for (int t_i=0;t_i<threads;t_i++) {
             // int s_i = get_socket_id(t_i);
@@ -1666,9 +2479,9 @@ public:
             }
             thread_state[t_i]->status = WORKING;
           }
-          #pragma omp parallel reduction(+:reducer)
+          #pragma omp parallel
           {
-            R local_reducer = 0;
+            R local_reducer = Op::identity();
             int thread_id = omp_get_thread_num();
             int s_i = get_socket_id(thread_id);
             while (true) {
@@ -1680,10 +2493,11 @@ public:
                 end_b_i = thread_state[thread_id]->end;
               }
               for (b_i=begin_b_i;b_i<end_b_i;b_i++) {
-                VertexId v_i = buffer[b_i].vertex;
-                M msg_data = buffer[b_i].msg_data;
+                const char * unit = buffer + unit_bytes * b_i;
+                VertexId v_i;
+                memcpy(&v_i, unit, sizeof(VertexId));
                 if (outgoing_adj_bitmap[s_i]->get_bit(v_i)) {
-                  local_reducer += sparse_slot(v_i, msg_data, VertexAdjList<EdgeData>(outgoing_adj_list[s_i] + outgoing_adj_index[s_i][v_i], outgoing_adj_list[s_i] + outgoing_adj_index[s_i][v_i+1]));
+                  Op::combine(local_reducer, sparse_slot(v_i, unit, payload, VertexAdjList<EdgeData>(outgoing_adj_list[s_i] + outgoing_adj_index[s_i][v_i], outgoing_adj_list[s_i] + outgoing_adj_index[s_i][v_i+1])));
                 }
               }
             }
@@ -1701,41 +2515,31 @@ public:
                 }
                 int s_i = get_socket_id(t_i);
                 for (b_i=begin_b_i;b_i<end_b_i;b_i++) {
-                  VertexId v_i = buffer[b_i].vertex;
-                  M msg_data = buffer[b_i].msg_data;
+                  const char * unit = buffer + unit_bytes * b_i;
+                  VertexId v_i;
+                  memcpy(&v_i, unit, sizeof(VertexId));
                   if (outgoing_adj_bitmap[s_i]->get_bit(v_i)) {
-                    local_reducer += sparse_slot(v_i, msg_data, VertexAdjList<EdgeData>(outgoing_adj_list[s_i] + outgoing_adj_index[s_i][v_i], outgoing_adj_list[s_i] + outgoing_adj_index[s_i][v_i+1]));
+                    Op::combine(local_reducer, sparse_slot(v_i, unit, payload, VertexAdjList<EdgeData>(outgoing_adj_list[s_i] + outgoing_adj_index[s_i][v_i], outgoing_adj_list[s_i] + outgoing_adj_index[s_i][v_i+1])));
                   }
                 }
               }
             }
-            reducer += local_reducer;
+            #pragma omp critical
+            Op::combine(reducer, local_reducer);
           }
         }
       }
-      send_thread.join();
-      recv_thread.join();
+      if (partitions > 1) {
+        send_thread.join();
+        recv_thread.join();
+      }
       delete [] recv_queue;
     } else {
       // dense selective bitmap
       if (dense_selective!=nullptr && partitions>1) {
         double sync_time = 0;
         sync_time -= get_time();
-        std::thread send_thread([&](){
-          for (int step=1;step<partitions;step++) {
-            int recipient_id = (partition_id + step) % partitions;
-            MPI_Send(dense_selective->data + WORD_OFFSET(partition_offset[partition_id]), owned_vertices / 64, MPI_UNSIGNED_LONG, recipient_id, PassMessage, MPI_COMM_WORLD);
-          }
-        });
-        std::thread recv_thread([&](){
-          for (int step=1;step<partitions;step++) {
-            int sender_id = (partition_id - step + partitions) % partitions;
-            MPI_Recv(dense_selective->data + WORD_OFFSET(partition_offset[sender_id]), (partition_offset[sender_id + 1] - partition_offset[sender_id]) / 64, MPI_UNSIGNED_LONG, sender_id, PassMessage, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-          }
-        });
-        send_thread.join();
-        recv_thread.join();
-        MPI_Barrier(MPI_COMM_WORLD);
+        sync_dense_selective(dense_selective);
         sync_time += get_time();
         #ifdef PRINT_DEBUG_MESSAGES
         if (partition_id==0) {
@@ -1755,55 +2559,64 @@ public:
       std::mutex send_queue_mutex;
       std::mutex recv_queue_mutex;
 
-      std::thread send_thread([&](){
-        for (int step=0;step<partitions;step++) {
-          if (step==partitions-1) {
-            break;
+      // a single partition has nothing to exchange, so no communication threads are started
+      std::thread send_thread;
+      std::thread recv_thread;
+      if (partitions > 1) {
+        send_thread = std::thread([&](){
+          for (int step=0;step<partitions;step++) {
+            if (step==partitions-1) {
+              break;
+            }
+            while (true) {
+              send_queue_mutex.lock();
+              bool condition = (send_queue_size<=step);
+              send_queue_mutex.unlock();
+              if (!condition) break;
+              __asm volatile ("pause" ::: "memory");
+            }
+            int i = send_queue[step];
+            for (int s_i=0;s_i<sockets;s_i++) {
+              send_messages(i, s_i, i);
+            }
           }
-          while (true) {
-            send_queue_mutex.lock();
-            bool condition = (send_queue_size<=step);
-            send_queue_mutex.unlock();
-            if (!condition) break;
-            __asm volatile ("pause" ::: "memory");
+        });
+        recv_thread = std::thread([&](){
+          std::vector<std::thread> threads;
+          for (int step=1;step<partitions;step++) {
+            int i = (partition_id - step + partitions) % partitions;
+            threads.emplace_back([&](int i){
+              for (int s_i=0;s_i<sockets;s_i++) {
+                recv_messages(i, s_i);
+              }
+            }, i);
           }
-          int i = send_queue[step];
-          for (int s_i=0;s_i<sockets;s_i++) {
-            MPI_Send(send_buffer[i][s_i]->data, sizeof(MsgUnit<M>) * send_buffer[i][s_i]->count, MPI_CHAR, i, PassMessage, MPI_COMM_WORLD);
+          for (int step=1;step<partitions;step++) {
+            int i = (partition_id - step + partitions) % partitions;
+            threads[step-1].join();
+            recv_queue[recv_queue_size] = i;
+            recv_queue_mutex.lock();
+            recv_queue_size += 1;
+            recv_queue_mutex.unlock();
           }
-        }
-      });
-      std::thread recv_thread([&](){
-        std::vector<std::thread> threads;
-        for (int step=1;step<partitions;step++) {
-          int i = (partition_id - step + partitions) % partitions;
-          threads.emplace_back([&](int i){
-            for (int s_i=0;s_i<sockets;s_i++) {
-              MPI_Status recv_status;
-              MPI_Probe(i, PassMessage, MPI_COMM_WORLD, &recv_status);
-              MPI_Get_count(&recv_status, MPI_CHAR, &recv_buffer[i][s_i]->count);
-              MPI_Recv(recv_buffer[i][s_i]->data, recv_buffer[i][s_i]->count, MPI_CHAR, i, PassMessage, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-              recv_buffer[i][s_i]->count /= sizeof(MsgUnit<M>);
-            }
-          }, i);
-        }
-        for (int step=1;step<partitions;step++) {
-          int i = (partition_id - step + partitions) % partitions;
-          threads[step-1].join();
-          recv_queue[recv_queue_size] = i;
+          recv_queue[recv_queue_size] = partition_id;
           recv_queue_mutex.lock();
           recv_queue_size += 1;
           recv_queue_mutex.unlock();
-        }
+        });
+      } else {
         recv_queue[recv_queue_size] = partition_id;
-        recv_queue_mutex.lock();
         recv_queue_size += 1;
-        recv_queue_mutex.unlock();
-      });
+      }
       current_send_part_id = partition_id;
+      prefetch_dense_step((current_send_part_id + 1) % partitions);
       for (int step=0;step<partitions;step++) {
         current_send_part_id = (current_send_part_id + 1) % partitions;
         int i = current_send_part_id;
+        if (step < partitions-1) {
+          // overlap reading the next step's lists with this step
+          prefetch_dense_step((i + 1) % partitions);
+        }
         for (int t_i=0;t_i<threads;t_i++) {
           *thread_state[t_i] = tuned_chunks_dense[i][t_i];
         }
@@ -1844,7 +2657,7 @@ public:
         }
         #pragma omp parallel for
         for (int t_i=0;t_i<threads;t_i++) {
-          flush_local_send_buffer<M>(t_i);
+          flush_local_send_buffer(t_i);
         }
         if (i!=partition_id) {
           send_queue[send_queue_size] = i;
@@ -1863,10 +2676,13 @@ public:
         }
         int i = recv_queue[step];
         MessageBuffer ** used_buffer;
+        MessageBuffer ** used_payload;
         if (i==partition_id) {
           used_buffer = send_buffer[i];
+          used_payload = send_payload_buffer[i];
         } else {
           used_buffer = recv_buffer[i];
+          used_payload = recv_payload_buffer[i];
         }
         for (int t_i=0;t_i<threads;t_i++) {
           int s_i = get_socket_id(t_i);
@@ -1879,12 +2695,13 @@ public:
           }
           thread_state[t_i]->status = WORKING;
         }
-        #pragma omp parallel reduction(+:reducer)
+        #pragma omp parallel
         {
-          R local_reducer = 0;
+          R local_reducer = Op::identity();
           int thread_id = omp_get_thread_num();
           int s_i = get_socket_id(thread_id);
-          MsgUnit<M> * buffer = (MsgUnit<M> *)used_buffer[s_i]->data;
+          const char * buffer = used_buffer[s_i]->data;
+          const char * payload = used_payload[s_i]->data;
           while (true) {
             VertexId b_i = __sync_fetch_and_add(&thread_state[thread_id]->curr, basic_chunk);
             if (b_i >= thread_state[thread_id]->end) break;
@@ -1894,24 +2711,26 @@ public:
               end_b_i = thread_state[thread_id]->end;
             }
             for (b_i=begin_b_i;b_i<end_b_i;b_i++) {
-              VertexId v_i = buffer[b_i].vertex;
-              M msg_data = buffer[b_i].msg_data;
-              local_reducer += dense_slot(v_i, msg_data);
+              const char * unit = buffer + unit_bytes * b_i;
+              VertexId v_i;
+              memcpy(&v_i, unit, sizeof(VertexId));
+              Op::combine(local_reducer, dense_slot(v_i, unit, payload));
             }
           }
           thread_state[thread_id]->status = STEALING;
-          reducer += local_reducer;
+          #pragma omp critical
+          Op::combine(reducer, local_reducer);
         }
       }
-      send_thread.join();
-      recv_thread.join();
+      if (partitions > 1) {
+        send_thread.join();
+        recv_thread.join();
+      }
       delete [] send_queue;
       delete [] recv_queue;
     }
 
-    R global_reducer;
-    MPI_Datatype dt = get_mpi_data_type<R>();
-    MPI_Allreduce(&reducer, &global_reducer, 1, dt, MPI_SUM, MPI_COMM_WORLD);
+    R global_reducer = reduce_partitions<R, Op>(reducer);
     stream_time += MPI_Wtime();
     #ifdef PRINT_DEBUG_MESSAGES
     if (partition_id==0) {
@@ -0,0 +1,220 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef LOCAL_MPI_HPP
+#define LOCAL_MPI_HPP
+
+// a single-process stand-in for the subset of MPI the engine uses, selected with -D LOCAL_MPI:
+// the world has exactly one rank, collectives are copies and point-to-point messages go through an in-process mailbox
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+typedef size_t MPI_Datatype; // the size of an element in bytes
+typedef int MPI_Op;
+typedef int MPI_Comm;
+typedef void (MPI_User_function)(void *, void *, int *, MPI_Datatype *);
+
+struct MPI_Status {
+  int MPI_SOURCE;
+  int MPI_TAG;
+  size_t bytes;
+};
+
+#define MPI_SUCCESS 0
+#define MPI_COMM_WORLD 0
+#define MPI_ANY_SOURCE -1
+#define MPI_ANY_TAG -1
+#define MPI_IN_PLACE ((void *)1)
+#define MPI_STATUS_IGNORE ((MPI_Status *)0)
+#define MPI_MAX_PROCESSOR_NAME 256
+
+#define MPI_DATATYPE_NULL ((MPI_Datatype)0)
+#define MPI_CHAR ((MPI_Datatype)sizeof(char))
+#define MPI_UNSIGNED_CHAR ((MPI_Datatype)sizeof(unsigned char))
+#define MPI_INT ((MPI_Datatype)sizeof(int))
+#define MPI_UNSIGNED ((MPI_Datatype)sizeof(unsigned))
+#define MPI_LONG ((MPI_Datatype)sizeof(long))
+#define MPI_UNSIGNED_LONG ((MPI_Datatype)sizeof(unsigned long))
+#define MPI_LONG_LONG ((MPI_Datatype)sizeof(long long))
+#define MPI_UNSIGNED_LONG_LONG ((MPI_Datatype)sizeof(unsigned long long))
+#define MPI_UINT64_T ((MPI_Datatype)sizeof(uint64_t))
+#define MPI_FLOAT ((MPI_Datatype)sizeof(float))
+#define MPI_DOUBLE ((MPI_Datatype)sizeof(double))
+
+#define MPI_OP_NULL 0
+#define MPI_SUM 1
+#define MPI_MIN 2
+#define MPI_MAX 3
+
+#define MPI_THREAD_SINGLE 0
+#define MPI_THREAD_FUNNELED 1
+#define MPI_THREAD_SERIALIZED 2
+#define MPI_THREAD_MULTIPLE 3
+
+// messages a rank sent to itself, in order
+struct LocalMailbox {
+  struct Message {
+    int tag;
+    std::vector<char> data;
+  };
+  std::mutex lock;
+  std::condition_variable arrived;
+  std::deque<Message> messages;
+  // the first message with tag (or any tag); called with lock held, waits until there is one
+  std::deque<Message>::iterator wait(std::unique_lock<std::mutex> & guard, int tag) {
+    while (true) {
+      for (auto it=messages.begin();it!=messages.end();it++) {
+        if (tag==MPI_ANY_TAG || it->tag==tag) return it;
+      }
+      arrived.wait(guard);
+    }
+  }
+};
+
+inline LocalMailbox & local_mailbox() {
+  static LocalMailbox mailbox;
+  return mailbox;
+}
+
+inline int MPI_Init_thread(int * argc, char *** argv, int required, int * provided) {
+  *provided = required;
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Finalize() {
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Comm_rank(MPI_Comm comm, int * rank) {
+  *rank = 0;
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Comm_size(MPI_Comm comm, int * size) {
+  *size = 1;
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Get_processor_name(char * name, int * length) {
+  gethostname(name, MPI_MAX_PROCESSOR_NAME);
+  name[MPI_MAX_PROCESSOR_NAME-1] = '\0';
+  *length = strlen(name);
+  return MPI_SUCCESS;
+}
+
+inline double MPI_Wtime() {
+  return omp_get_wtime();
+}
+
+inline int MPI_Type_contiguous(int count, MPI_Datatype old_type, MPI_Datatype * new_type) {
+  *new_type = count * old_type;
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Type_commit(MPI_Datatype * type) {
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Op_create(MPI_User_function * function, int commute, MPI_Op * op) {
+  static int ops = MPI_MAX;
+  *op = ++ops;
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Barrier(MPI_Comm comm) {
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Bcast(void * buffer, int count, MPI_Datatype type, int root, MPI_Comm comm) {
+  return MPI_SUCCESS;
+}
+
+// with a single rank, every reduction or gather leaves the rank's own contribution in the receive buffer
+
+inline int MPI_Allreduce(const void * send_buffer, void * recv_buffer, int count, MPI_Datatype type, MPI_Op op, MPI_Comm comm) {
+  if (send_buffer!=MPI_IN_PLACE) {
+    memmove(recv_buffer, send_buffer, count * type);
+  }
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Allgather(const void * send_buffer, int send_count, MPI_Datatype send_type, void * recv_buffer, int recv_count, MPI_Datatype recv_type, MPI_Comm comm) {
+  if (send_buffer!=MPI_IN_PLACE) {
+    memmove(recv_buffer, send_buffer, send_count * send_type);
+  }
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Allgatherv(const void * send_buffer, int send_count, MPI_Datatype send_type, void * recv_buffer, const int * recv_counts, const int * displs, MPI_Datatype recv_type, MPI_Comm comm) {
+  if (send_buffer!=MPI_IN_PLACE) {
+    memmove((char *)recv_buffer + displs[0] * recv_type, send_buffer, send_count * send_type);
+  }
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Send(const void * buffer, int count, MPI_Datatype type, int dest, int tag, MPI_Comm comm) {
+  LocalMailbox & mailbox = local_mailbox();
+  LocalMailbox::Message message;
+  message.tag = tag;
+  message.data.assign((const char *)buffer, (const char *)buffer + count * type);
+  {
+    std::lock_guard<std::mutex> guard(mailbox.lock);
+    mailbox.messages.push_back(std::move(message));
+  }
+  mailbox.arrived.notify_all();
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status * status) {
+  LocalMailbox & mailbox = local_mailbox();
+  std::unique_lock<std::mutex> guard(mailbox.lock);
+  auto it = mailbox.wait(guard, tag);
+  status->MPI_SOURCE = 0;
+  status->MPI_TAG = it->tag;
+  status->bytes = it->data.size();
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Get_count(const MPI_Status * status, MPI_Datatype type, int * count) {
+  *count = status->bytes / type;
+  return MPI_SUCCESS;
+}
+
+inline int MPI_Recv(void * buffer, int count, MPI_Datatype type, int source, int tag, MPI_Comm comm, MPI_Status * status) {
+  LocalMailbox & mailbox = local_mailbox();
+  std::unique_lock<std::mutex> guard(mailbox.lock);
+  auto it = mailbox.wait(guard, tag);
+  assert(it->data.size() <= count * type);
+  memcpy(buffer, it->data.data(), it->data.size());
+  if (status!=MPI_STATUS_IGNORE) {
+    status->MPI_SOURCE = 0;
+    status->MPI_TAG = it->tag;
+    status->bytes = it->data.size();
+  }
+  mailbox.messages.erase(it);
+  return MPI_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,357 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <numa.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "core/bitmap.hpp"
+#include "core/constants.hpp"
+#include "core/type.hpp"
+
+#define HUGEPAGE_NONE 0 // base pages only
+#define HUGEPAGE_TRANSPARENT 1 // 2 MB aligned mappings advised with MADV_HUGEPAGE
+#define HUGEPAGE_HUGETLB 2 // MAP_HUGETLB from the reserved pool, falling back to HUGEPAGE_TRANSPARENT
+
+#ifndef HUGEPAGE_POLICY
+#define HUGEPAGE_POLICY HUGEPAGE_TRANSPARENT
+#endif
+
+#define HUGEPAGESIZE (1<<21)
+
+#define EXTERNAL_NODE -2 // accounting node of structures kept in files rather than in memory
+
+// mappings smaller than this stay on base pages
+#ifndef HUGEPAGE_THRESHOLD
+#define HUGEPAGE_THRESHOLD HUGEPAGESIZE
+#endif
+
+// granularity of a mapping of size bytes; placement (e.g. numa_tonode_memory) should respect it
+inline size_t page_granularity(size_t size) {
+  if (HUGEPAGE_POLICY==HUGEPAGE_NONE || size < HUGEPAGE_THRESHOLD) {
+    return PAGESIZE;
+  }
+  return HUGEPAGESIZE;
+}
+
+// length of the mapping backing size bytes; deterministic so that unmapping needs only the size
+inline size_t mapped_size(size_t size) {
+  if (size==0) {
+    return PAGESIZE;
+  }
+  size_t granularity = page_granularity(size);
+  return (size + granularity - 1) / granularity * granularity;
+}
+
+// map at least size bytes of zeroed, untouched memory; page_size receives the page size requested from the kernel
+inline char * map_pages(size_t size, size_t * page_size) {
+  size_t length = mapped_size(size);
+  if (HUGEPAGE_POLICY==HUGEPAGE_HUGETLB && length >= HUGEPAGE_THRESHOLD) {
+    void * data = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data!=MAP_FAILED) {
+      *page_size = HUGEPAGESIZE;
+      return (char *)data;
+    }
+  }
+  if (HUGEPAGE_POLICY!=HUGEPAGE_NONE && length >= HUGEPAGE_THRESHOLD) {
+    // over-map by one huge page and trim, so that the mapping starts on a huge page boundary
+    char * data = (char *)mmap(NULL, length + HUGEPAGESIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(data!=MAP_FAILED);
+    size_t head = (HUGEPAGESIZE - (uintptr_t)data % HUGEPAGESIZE) % HUGEPAGESIZE;
+    if (head > 0) {
+      munmap(data, head);
+    }
+    munmap(data + head + length, HUGEPAGESIZE - head);
+    data += head;
+    *page_size = madvise(data, length, MADV_HUGEPAGE)==0 ? HUGEPAGESIZE : PAGESIZE;
+    return data;
+  }
+  char * data = (char *)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  assert(data!=MAP_FAILED);
+  *page_size = PAGESIZE;
+  return data;
+}
+
+inline void unmap_pages(void * data, size_t size) {
+  assert(munmap(data, mapped_size(size))==0);
+}
+
+// bytes of the process backed by huge pages according to /proc/self/smaps
+inline size_t huge_page_bytes() {
+  FILE * fin = fopen("/proc/self/smaps", "r");
+  if (fin==NULL) {
+    return 0;
+  }
+  size_t bytes = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), fin)!=NULL) {
+    unsigned long kb;
+    if (sscanf(line, "AnonHugePages: %lu kB", &kb)==1 || sscanf(line, "Private_Hugetlb: %lu kB", &kb)==1) {
+      bytes += kb << 10;
+    }
+  }
+  fclose(fin);
+  return bytes;
+}
+
+// bytes of a rank by structure and numa node (-1 for interleaved or unbound memory), with the peak total in memory;
+// large structures are mapped through it, smaller ones (bitmaps, message and loading buffers) are only accounted
+class MemoryMap {
+  struct Mapping {
+    std::string name;
+    size_t bytes;
+    size_t page_size;
+    bool file;
+    std::map<int, size_t> nodes; // node -> bytes bound there
+  };
+  std::mutex lock;
+  std::map<void *, Mapping> mappings;
+  std::map<std::string, std::map<int, long> > usage; // name -> node -> bytes
+  std::map<std::string, long> huge_usage; // name -> bytes mapped with huge pages
+  long current_bytes;
+  long peak_bytes;
+  void release(void * data, Mapping & mapping) {
+    if (mapping.file) {
+      assert(munmap(data, mapping.bytes==0 ? PAGESIZE : (mapping.bytes + PAGESIZE - 1) / PAGESIZE * PAGESIZE)==0);
+    } else {
+      unmap_pages(data, mapping.bytes);
+    }
+  }
+  void add(const std::string & name, int node, long bytes) {
+    usage[name][node] += bytes;
+    if (node==EXTERNAL_NODE) return;
+    current_bytes += bytes;
+    if (current_bytes > peak_bytes) {
+      peak_bytes = current_bytes;
+    }
+  }
+public:
+  MemoryMap() : current_bytes(0), peak_bytes(0) { }
+  ~MemoryMap() {
+    for (auto & it : mappings) {
+      release(it.first, it.second);
+    }
+  }
+  char * map(std::string name, size_t bytes) {
+    size_t page_size;
+    char * data = map_pages(bytes, &page_size);
+    std::lock_guard<std::mutex> guard(lock);
+    Mapping & mapping = mappings[data];
+    mapping.name = name;
+    mapping.bytes = bytes;
+    mapping.page_size = page_size;
+    mapping.file = false;
+    mapping.nodes[-1] = bytes;
+    add(name, -1, bytes);
+    if (page_size==HUGEPAGESIZE) {
+      huge_usage[name] += bytes;
+    }
+    return data;
+  }
+  // map bytes backed by a new file at path, which is unlinked right away so that it goes away with the mapping;
+  // the page cache holds what is in use and the kernel writes back and evicts the rest
+  char * map_file(std::string name, size_t bytes, std::string path) {
+    size_t length = bytes==0 ? PAGESIZE : (bytes + PAGESIZE - 1) / PAGESIZE * PAGESIZE;
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    assert(fd!=-1);
+    assert(ftruncate(fd, length)==0);
+    char * data = (char *)mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert(data!=MAP_FAILED);
+    assert(close(fd)==0);
+    assert(unlink(path.c_str())==0);
+    std::lock_guard<std::mutex> guard(lock);
+    Mapping & mapping = mappings[data];
+    mapping.name = name;
+    mapping.bytes = bytes;
+    mapping.page_size = PAGESIZE;
+    mapping.file = true;
+    mapping.nodes[EXTERNAL_NODE] = bytes;
+    add(name, EXTERNAL_NODE, bytes);
+    return data;
+  }
+  // bind [offset, offset+length) of a mapping to a numa node; ranges of one mapping must not overlap
+  void bind(void * data, size_t offset, size_t length, int node) {
+    numa_tonode_memory((char *)data + offset, length, node);
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = mappings.find(data);
+    assert(it!=mappings.end());
+    Mapping & mapping = it->second;
+    if (offset >= mapping.bytes) return;
+    length = std::min(length, mapping.bytes - offset);
+    mapping.nodes[-1] -= length;
+    mapping.nodes[node] += length;
+    usage[mapping.name][-1] -= length;
+    usage[mapping.name][node] += length;
+  }
+  // give back the pages of a mapping beyond its first bytes; nodes are debited from the highest one down
+  void shrink(void * data, size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = mappings.find(data);
+    assert(it!=mappings.end());
+    Mapping & mapping = it->second;
+    assert(bytes <= mapping.bytes);
+    size_t old_length, new_length;
+    if (mapping.file) {
+      old_length = mapping.bytes==0 ? PAGESIZE : (mapping.bytes + PAGESIZE - 1) / PAGESIZE * PAGESIZE;
+      new_length = bytes==0 ? PAGESIZE : (bytes + PAGESIZE - 1) / PAGESIZE * PAGESIZE;
+    } else {
+      old_length = mapped_size(mapping.bytes);
+      new_length = mapped_size(bytes);
+    }
+    if (new_length < old_length) {
+      assert(munmap((char *)data + new_length, old_length - new_length)==0);
+    }
+    size_t released = mapping.bytes - bytes;
+    for (auto node=mapping.nodes.rbegin();node!=mapping.nodes.rend() && released > 0;node++) {
+      size_t debit = std::min(released, node->second);
+      node->second -= debit;
+      add(mapping.name, node->first, -(long)debit);
+      released -= debit;
+    }
+    if (mapping.page_size==HUGEPAGESIZE) {
+      huge_usage[mapping.name] -= mapping.bytes - bytes;
+    }
+    mapping.bytes = bytes;
+  }
+  void unmap(void * data) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = mappings.find(data);
+    assert(it!=mappings.end());
+    Mapping & mapping = it->second;
+    for (auto & node : mapping.nodes) {
+      add(mapping.name, node.first, -(long)node.second);
+    }
+    if (mapping.page_size==HUGEPAGESIZE) {
+      huge_usage[mapping.name] -= mapping.bytes;
+    }
+    release(data, mapping);
+    mappings.erase(it);
+  }
+  // record bytes (negative when released) of a structure that is not mapped through this map
+  void account(std::string name, int node, long bytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    add(name, node, bytes);
+  }
+  long total() {
+    std::lock_guard<std::mutex> guard(lock);
+    return current_bytes;
+  }
+  long peak() {
+    std::lock_guard<std::mutex> guard(lock);
+    return peak_bytes;
+  }
+  // one line per structure with its bytes on each node and on huge pages, then the totals per node and the peak
+  void print(int partition_id) {
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<int, long> node_bytes;
+    for (auto & it : usage) {
+      std::string nodes;
+      long bytes = 0;
+      for (auto & node : it.second) {
+        if (node.second==0) continue;
+        char buffer[64];
+        if (node.first==-1) {
+          sprintf(buffer, " interleaved=%ld", node.second);
+        } else if (node.first==EXTERNAL_NODE) {
+          sprintf(buffer, " external=%ld", node.second);
+        } else {
+          sprintf(buffer, " node%d=%ld", node.first, node.second);
+        }
+        nodes += buffer;
+        bytes += node.second;
+        node_bytes[node.first] += node.second;
+      }
+      if (bytes==0) continue;
+      printf("part(%d) %s: %ld bytes (%s), %ld on 2M pages\n", partition_id, it.first.c_str(), bytes, nodes.c_str() + 1, huge_usage[it.first]);
+    }
+    for (auto & it : node_bytes) {
+      if (it.first==-1) {
+        printf("part(%d) interleaved: %ld bytes\n", partition_id, it.second);
+      } else if (it.first==EXTERNAL_NODE) {
+        printf("part(%d) external: %ld bytes\n", partition_id, it.second);
+      } else {
+        printf("part(%d) node(%d): %ld bytes\n", partition_id, it.first, it.second);
+      }
+    }
+    printf("part(%d) total in memory: %ld bytes, peak: %ld bytes\n", partition_id, current_bytes, peak_bytes);
+    printf("part(%d) huge pages in use: %lu bytes\n", partition_id, huge_page_bytes());
+  }
+};
+
+// predicted bytes of one rank, by structure, using the names Graph accounts them under; vertex arrays are counted
+// in full (as mapped) and edges are assumed to spread evenly over ranks and sockets; each of the toolkit's vertex
+// subsets is counted with its queue and the dirty words of sync_dense_selective
+struct MemoryPlan {
+  std::map<std::string, size_t> loaded; // after loading, with message buffers grown by the first process_edges
+  size_t loaded_bytes;
+  size_t loading_peak_bytes; // while load_directed / load_undirected_from_directed runs
+};
+
+inline MemoryPlan plan_memory(VertexId vertices, EdgeId edges, int partitions, int sockets, size_t edge_data_size, bool symmetric, size_t message_size = sizeof(double), int subsets = 2) {
+  MemoryPlan plan;
+  size_t unit_size = sizeof(VertexId) + edge_data_size;
+  size_t edge_unit_size = sizeof(VertexId) + unit_size;
+  size_t msg_unit_size = sizeof(VertexId) + message_size;
+  VertexId owned_vertices = (vertices + partitions - 1) / partitions;
+  EdgeId local_edges = (symmetric ? edges * 2 : edges) / partitions; // an undirected load stores both directions
+  EdgeId socket_edges = local_edges / sockets;
+  int directions = symmetric ? 1 : 2;
+
+  std::map<std::string, size_t> & loaded = plan.loaded;
+  loaded["vertex arrays"] = sizeof(VertexId) * vertices * directions; // out_degree (and in_degree)
+  const char * prefixes[2] = {"outgoing", "incoming"};
+  for (int d_i=0;d_i<directions;d_i++) {
+    std::string prefix = prefixes[d_i];
+    loaded[prefix + "_adj_bitmap"] = sockets * (WORD_OFFSET(vertices) + 1) * sizeof(unsigned long);
+    loaded[prefix + "_adj_index"] = sockets * sizeof(EdgeId) * (vertices + 1);
+    loaded["compressed_" + prefix + "_adj_index"] = sockets * sizeof(CompressedAdjIndexUnit) * (std::min((EdgeId)vertices, socket_edges) + 1);
+    loaded[prefix + "_adj_list"] = sockets * unit_size * socket_edges;
+  }
+  size_t subset_words = WORD_OFFSET(vertices) + 1;
+  loaded["vertex_subset"] = subsets * (subset_words * sizeof(unsigned long) + subset_words * sizeof(size_t) + (WORD_OFFSET(subset_words) + 1) * sizeof(unsigned long));
+  // every (partition, socket) pair gets a send and a receive buffer for owned_vertices * sockets messages
+  size_t message_buffers = (size_t)partitions * sockets * std::max((size_t)PAGESIZE, msg_unit_size * owned_vertices * sockets);
+  loaded["send_buffer"] = message_buffers;
+  loaded["recv_buffer"] = message_buffers;
+
+  plan.loaded_bytes = 0;
+  for (auto & it : loaded) {
+    plan.loaded_bytes += it.second;
+  }
+  // while loading, message buffers are still at their initial size, the interleaved out_degree briefly coexists with
+  // its replacement and the shuffle buffers (one chunk per destination rank, plus one to read and one to receive) are alive
+  size_t loading_buffers = (size_t)(partitions + 2) * CHUNKSIZE * edge_unit_size;
+  plan.loading_peak_bytes = plan.loaded_bytes - 2 * message_buffers + 2 * (size_t)partitions * sockets * PAGESIZE + loading_buffers;
+  if (symmetric) {
+    plan.loading_peak_bytes += sizeof(VertexId) * vertices;
+  }
+  return plan;
+}
+
+#endif
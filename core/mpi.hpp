@@ -20,35 +20,123 @@ Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
+#ifdef LOCAL_MPI
+#include "core/local_mpi.hpp"
+#else
 #include <mpi.h>
+#endif
+
+#include <limits>
+#include <type_traits>
+
+// compile-time table of MPI datatypes; any other trivially copyable type is shipped as an opaque run of bytes
+template <typename T>
+struct MPIDataType {
+  static MPI_Datatype get() {
+    static_assert(std::is_trivially_copyable<T>::value, "type not supported");
+    static MPI_Datatype dt = MPI_DATATYPE_NULL;
+    if (dt==MPI_DATATYPE_NULL) {
+      MPI_Type_contiguous(sizeof(T), MPI_CHAR, &dt);
+      MPI_Type_commit(&dt);
+    }
+    return dt;
+  }
+};
+
+#define DEFINE_MPI_DATA_TYPE(type, mpi_type) \
+template <> \
+struct MPIDataType<type> { \
+  static MPI_Datatype get() { return mpi_type; } \
+};
+
+DEFINE_MPI_DATA_TYPE(char, MPI_CHAR)
+DEFINE_MPI_DATA_TYPE(unsigned char, MPI_UNSIGNED_CHAR)
+DEFINE_MPI_DATA_TYPE(int, MPI_INT)
+DEFINE_MPI_DATA_TYPE(unsigned, MPI_UNSIGNED)
+DEFINE_MPI_DATA_TYPE(long, MPI_LONG)
+DEFINE_MPI_DATA_TYPE(long long, MPI_LONG_LONG)
+// 64-bit unsigned types (VertexId, EdgeId) go as MPI_UINT64_T: some implementations (e.g. OpenMPI 4.1) compare
+// MPI_UNSIGNED_LONG and MPI_UNSIGNED_LONG_LONG as signed in MPI_MIN/MPI_MAX, which breaks values of 2^63 and above
+// such as the identity of MinReduction
+static_assert(sizeof(unsigned long)==sizeof(uint64_t) && sizeof(unsigned long long)==sizeof(uint64_t), "64-bit unsigned types expected");
+DEFINE_MPI_DATA_TYPE(unsigned long, MPI_UINT64_T)
+DEFINE_MPI_DATA_TYPE(unsigned long long, MPI_UINT64_T)
+DEFINE_MPI_DATA_TYPE(float, MPI_FLOAT)
+DEFINE_MPI_DATA_TYPE(double, MPI_DOUBLE)
 
 template <typename T>
 MPI_Datatype get_mpi_data_type() {
-  if (std::is_same<T, char>::value) {
-    return MPI_CHAR;
-  } else if (std::is_same<T, unsigned char>::value) {
-    return MPI_UNSIGNED_CHAR;
-  } else if (std::is_same<T, int>::value) {
-    return MPI_INT;
-  } else if (std::is_same<T, unsigned>::value) {
-    return MPI_UNSIGNED;
-  } else if (std::is_same<T, long>::value) {
-    return MPI_LONG;
-  } else if (std::is_same<T, unsigned long>::value) {
-    return MPI_UNSIGNED_LONG;
-  } else if (std::is_same<T, uint64_t>::value) {
-#ifdef PRINT_DEBUG_MESSAGES
-	  printf("Found uint64_t datatype for vertices\n");
-#endif
-    return MPI_UINT64_T;
-  } else if (std::is_same<T, float>::value) {
-    return MPI_FLOAT;
-  } else if (std::is_same<T, double>::value) {
-    return MPI_DOUBLE;
-  } else {
-    printf("type not supported\n");
-    exit(-1);
+  return MPIDataType<T>::get();
+}
+
+// reduction operators for process_vertices/process_edges: identity() seeds every partial result and combine() folds b into a
+// operators deriving from UserReduction are run by MPI through a user-defined MPI_Op
+struct UserReduction {
+  static MPI_Op builtin() {
+    return MPI_OP_NULL;
+  }
+};
+
+template <typename T>
+struct SumReduction {
+  static T identity() {
+    return T();
+  }
+  static void combine(T & a, const T & b) {
+    a += b;
+  }
+  static MPI_Op builtin() {
+    return MPI_SUM;
+  }
+};
+
+template <typename T>
+struct MinReduction {
+  static T identity() {
+    return std::numeric_limits<T>::max();
+  }
+  static void combine(T & a, const T & b) {
+    if (b < a) a = b;
+  }
+  static MPI_Op builtin() {
+    return MPI_MIN;
+  }
+};
+
+template <typename T>
+struct MaxReduction {
+  static T identity() {
+    return std::numeric_limits<T>::lowest();
+  }
+  static void combine(T & a, const T & b) {
+    if (b > a) a = b;
+  }
+  static MPI_Op builtin() {
+    return MPI_MAX;
+  }
+};
+
+template <typename T, typename Op>
+void mpi_reduce_function(void * in, void * inout, int * len, MPI_Datatype * dt) {
+  T * a = (T *)inout;
+  T * b = (T *)in;
+  for (int i=0;i<*len;i++) {
+    Op::combine(a[i], b[i]);
+  }
+}
+
+// builtin operators apply only to builtin datatypes; everything else goes through a (cached) user-defined operator
+template <typename T, typename Op>
+MPI_Op get_mpi_op() {
+  if (std::is_arithmetic<T>::value && Op::builtin()!=MPI_OP_NULL) {
+    return Op::builtin();
+  }
+  static MPI_Op op = MPI_OP_NULL;
+  if (op==MPI_OP_NULL) {
+    MPI_Op_create(mpi_reduce_function<T, Op>, 1, &op);
   }
+  return op;
 }
 
 class MPI_Instance {
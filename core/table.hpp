@@ -0,0 +1,86 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef TABLE_HPP
+#define TABLE_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "core/type.hpp"
+
+// sums of values by vertex id (a label, a community, ...) over one vertex's neighbourhood, in an open-addressing
+// table; each thread keeps one and reuses it across vertices, resetting only the slots it touched
+template <typename T>
+class VertexTable {
+  static const VertexId NO_KEY = (VertexId)-1;
+  std::vector<VertexId> keys;
+  std::vector<T> values;
+  std::vector<size_t> touched;
+  int bits;
+public:
+  VertexTable() : bits(0) { }
+  // makes room for up to distinct keys at a load factor of at most 1/2
+  void reserve(VertexId distinct) {
+    if (!keys.empty() && ((size_t)1 << bits) >= distinct * 2) return;
+    bits = std::max(bits, 4);
+    while (((size_t)1 << bits) < distinct * 2) {
+      bits++;
+    }
+    keys.assign((size_t)1 << bits, NO_KEY);
+    values.assign((size_t)1 << bits, T());
+  }
+  void add(VertexId key, T value) {
+    size_t mask = keys.size() - 1;
+    size_t slot = (key * 0x9E3779B97F4A7C15ull) >> (64 - bits);
+    while (keys[slot]!=key) {
+      if (keys[slot]==NO_KEY) {
+        keys[slot] = key;
+        touched.push_back(slot);
+        break;
+      }
+      slot = (slot + 1) & mask;
+    }
+    values[slot] += value;
+  }
+  // the sum of key, T() if it was not added
+  T get(VertexId key) {
+    size_t mask = keys.size() - 1;
+    size_t slot = (key * 0x9E3779B97F4A7C15ull) >> (64 - bits);
+    while (keys[slot]!=NO_KEY) {
+      if (keys[slot]==key) {
+        return values[slot];
+      }
+      slot = (slot + 1) & mask;
+    }
+    return T();
+  }
+  // calls visit(key, sum) for every key added and empties the table
+  template <typename F>
+  void drain(F visit) {
+    for (size_t slot : touched) {
+      visit(keys[slot], values[slot]);
+      keys[slot] = NO_KEY;
+      values[slot] = T();
+    }
+    touched.clear();
+  }
+};
+
+template <typename T>
+const VertexId VertexTable<T>::NO_KEY;
+
+#endif
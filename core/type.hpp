@@ -57,6 +57,17 @@ struct AdjUnit <Empty> {
   };
 } __attribute__((packed));
 
+// orders adjacency units by neighbour, then by edge data (lightest first)
+template <typename EdgeData>
+inline bool adj_unit_less(const AdjUnit<EdgeData> & a, const AdjUnit<EdgeData> & b) {
+  return a.neighbour < b.neighbour || (a.neighbour == b.neighbour && a.edge_data < b.edge_data);
+}
+
+template <>
+inline bool adj_unit_less<Empty>(const AdjUnit<Empty> & a, const AdjUnit<Empty> & b) {
+  return a.neighbour < b.neighbour;
+}
+
 struct CompressedAdjIndexUnit {
   EdgeId index;
   VertexId vertex;
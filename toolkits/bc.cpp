@@ -31,6 +31,8 @@ void compute(Graph<Empty> * graph, VertexId root) {
   VertexSubset * active_all = graph->alloc_vertex_subset();
   active_all->fill();
   VertexSubset * visited = graph->alloc_vertex_subset();
+  // path counts on the way forward, dependencies on the way back
+  Accumulator<double, SumReduction<double>> * paths = graph->alloc_accumulator<double>();
   std::vector<VertexSubset *> levels;
   VertexSubset * active_in = graph->alloc_vertex_subset();
 
@@ -60,10 +62,7 @@ void compute(Graph<Empty> * graph, VertexId root) {
         for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
           VertexId dst = ptr->neighbour;
           if (!visited->get_bit(dst)) {
-            if (num_paths[dst]==0) {
-              active_out->set_bit(dst);
-            }
-            write_add(&num_paths[dst], msg);
+            paths->add(dst, msg);
           }
         }
         return 0;
@@ -90,6 +89,7 @@ void compute(Graph<Empty> * graph, VertexId root) {
       },
       active_in, visited
     );
+    paths->flush(num_paths, active_out);
     active_vertices = graph->process_vertices<VertexId>(
       [&](VertexId vtx) {
         visited->set_bit(vtx);
@@ -132,7 +132,7 @@ void compute(Graph<Empty> * graph, VertexId root) {
         for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
           VertexId dst = ptr->neighbour;
           if (!visited->get_bit(dst)) {
-            write_add(&dependencies[dst], msg);
+            paths->add(dst, msg);
           }
         }
         return 0;
@@ -156,6 +156,7 @@ void compute(Graph<Empty> * graph, VertexId root) {
       },
       levels.back(), visited
     );
+    paths->flush(dependencies);
     delete levels.back();
     levels.pop_back();
     graph->process_vertices<VertexId>(
@@ -194,6 +195,7 @@ void compute(Graph<Empty> * graph, VertexId root) {
   graph->dealloc_vertex_array(inv_num_paths);
   delete visited;
   delete active_all;
+  delete paths;
 }
 
 // an implementation which uses an array to store the levels instead of multiple bitmaps
@@ -206,6 +208,8 @@ void compute_compact(Graph<Empty> * graph, VertexId root) {
   VertexSubset * active_all = graph->alloc_vertex_subset();
   active_all->fill();
   VertexSubset * visited = graph->alloc_vertex_subset();
+  // path counts on the way forward, dependencies on the way back
+  Accumulator<double, SumReduction<double>> * paths = graph->alloc_accumulator<double>();
   VertexId * level = graph->alloc_vertex_array<VertexId>();
   VertexSubset * active_in = graph->alloc_vertex_subset();
   VertexSubset * active_out = graph->alloc_vertex_subset();
@@ -245,10 +249,7 @@ void compute_compact(Graph<Empty> * graph, VertexId root) {
         for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
           VertexId dst = ptr->neighbour;
           if (!visited->get_bit(dst)) {
-            if (num_paths[dst]==0) {
-              active_out->set_bit(dst);
-            }
-            write_add(&num_paths[dst], msg);
+            paths->add(dst, msg);
           }
         }
         return 0;
@@ -275,6 +276,7 @@ void compute_compact(Graph<Empty> * graph, VertexId root) {
       },
       active_in, visited
     );
+    paths->flush(num_paths, active_out);
     active_vertices = graph->process_vertices<VertexId>(
       [&](VertexId vtx) {
         visited->set_bit(vtx);
@@ -328,7 +330,7 @@ void compute_compact(Graph<Empty> * graph, VertexId root) {
         for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
           VertexId dst = ptr->neighbour;
           if (!visited->get_bit(dst)) {
-            write_add(&dependencies[dst], msg);
+            paths->add(dst, msg);
           }
         }
         return 0;
@@ -352,6 +354,7 @@ void compute_compact(Graph<Empty> * graph, VertexId root) {
       },
       active_in, visited
     );
+    paths->flush(dependencies);
     i_i--;
     active_in->clear();
     active_vertices = graph->process_vertices<VertexId>(
@@ -400,6 +403,7 @@ void compute_compact(Graph<Empty> * graph, VertexId root) {
   graph->dealloc_vertex_array(inv_num_paths);
   delete visited;
   delete active_all;
+  delete paths;
   delete active_in;
   delete active_out;
 }
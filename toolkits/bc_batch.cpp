@@ -0,0 +1,355 @@
+/*
+Copyright (c) 2014-2015 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+
+#include "core/graph.hpp"
+
+// number of roots processed together; every vertex keeps one lane per root
+#ifndef LANES
+#define LANES 16
+#endif
+
+#define UNVISITED 0xffffffffu
+
+struct PathLanes {
+  double lane[LANES];
+};
+
+struct DepthLanes {
+  unsigned lane[LANES];
+};
+
+// pick the roots on partition 0 and broadcast them; weight[i] scales root i so that the sum over roots estimates BC
+void sample_roots(Graph<Empty> * graph, VertexId samples, std::string strategy, unsigned seed, std::vector<VertexId> & roots, std::vector<double> & weight) {
+  VertexId vertices = graph->vertices;
+  if (samples==0) {
+    // exact betweenness centrality
+    for (VertexId v_i=0;v_i<vertices;v_i++) {
+      roots.push_back(v_i);
+      weight.push_back(1.0);
+    }
+    return;
+  }
+  roots.resize(samples);
+  weight.resize(samples);
+  if (strategy=="degree") {
+    // degree-proportional importance sampling, weighted by 1 / (samples * p(root))
+    VertexId * degree = graph->alloc_vertex_array<VertexId>();
+    memcpy(degree + graph->partition_offset[graph->partition_id], graph->out_degree + graph->partition_offset[graph->partition_id], sizeof(VertexId) * graph->owned_vertices);
+    graph->gather_vertex_array(degree, 0);
+    if (graph->partition_id==0) {
+      std::vector<double> prefix(vertices);
+      double total = 0;
+      for (VertexId v_i=0;v_i<vertices;v_i++) {
+        total += degree[v_i];
+        prefix[v_i] = total;
+      }
+      std::mt19937 gen(seed);
+      std::uniform_real_distribution<double> udist(0, total);
+      for (VertexId s_i=0;s_i<samples;s_i++) {
+        VertexId root = std::upper_bound(prefix.begin(), prefix.end(), udist(gen)) - prefix.begin();
+        if (root >= vertices) root = vertices - 1;
+        roots[s_i] = root;
+        weight[s_i] = total / (samples * (double)degree[root]);
+      }
+    }
+    graph->dealloc_vertex_array(degree);
+  } else {
+    assert(strategy=="uniform");
+    if (graph->partition_id==0) {
+      std::mt19937 gen(seed);
+      std::uniform_int_distribution<unsigned long> udist(0, vertices - 1);
+      for (VertexId s_i=0;s_i<samples;s_i++) {
+        roots[s_i] = udist(gen);
+        weight[s_i] = (double)vertices / samples;
+      }
+    }
+  }
+  MPI_Bcast(roots.data(), samples, get_mpi_data_type<VertexId>(), 0, MPI_COMM_WORLD);
+  MPI_Bcast(weight.data(), samples, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+}
+
+void compute(Graph<Empty> * graph, std::vector<VertexId> & roots, std::vector<double> & weight) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  PathLanes * num_paths = graph->alloc_vertex_array<PathLanes>();
+  PathLanes * dependencies = graph->alloc_vertex_array<PathLanes>();
+  DepthLanes * depth = graph->alloc_vertex_array<DepthLanes>();
+  double * centrality = graph->alloc_vertex_array<double>();
+  VertexSubset * active_all = graph->alloc_vertex_subset();
+  active_all->fill();
+  // levels[i] holds the vertices that are at depth i for at least one root; kept across batches
+  std::vector<VertexSubset *> levels;
+
+  graph->fill_vertex_array(centrality, 0.0);
+  VertexId begin_v_i = graph->partition_offset[graph->partition_id];
+  VertexId end_v_i = graph->partition_offset[graph->partition_id+1];
+  for (size_t batch_begin=0;batch_begin<roots.size();batch_begin+=LANES) {
+    size_t batch_size = std::min((size_t)LANES, roots.size() - batch_begin);
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        for (int k=0;k<LANES;k++) {
+          num_paths[vtx].lane[k] = 0;
+          depth[vtx].lane[k] = UNVISITED;
+        }
+        return 0;
+      },
+      active_all
+    );
+    if (levels.empty()) {
+      levels.push_back(graph->alloc_vertex_subset());
+    }
+    levels[0]->clear();
+    for (size_t k=0;k<batch_size;k++) {
+      VertexId root = roots[batch_begin + k];
+      if (root >= begin_v_i && root < end_v_i) {
+        num_paths[root].lane[k] = 1.0;
+        depth[root].lane[k] = 0;
+        levels[0]->set_bit(root);
+      }
+    }
+
+    // forward: count shortest paths for all lanes at once
+    VertexId active_vertices = 1;
+    unsigned level;
+    for (level=0;active_vertices>0;level++) {
+      if (levels.size() <= level + 1) {
+        levels.push_back(graph->alloc_vertex_subset());
+      }
+      VertexSubset * active_in = levels[level];
+      VertexSubset * active_out = levels[level+1];
+      active_out->clear();
+      graph->process_edges<VertexId,PathLanes>(
+        [&](VertexId src){
+          PathLanes msg;
+          for (int k=0;k<LANES;k++) {
+            msg.lane[k] = depth[src].lane[k]==level ? num_paths[src].lane[k] : 0;
+          }
+          graph->emit(src, msg);
+        },
+        [&](VertexId src, PathLanes msg, VertexAdjList<Empty> outgoing_adj){
+          for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+            VertexId dst = ptr->neighbour;
+            for (int k=0;k<LANES;k++) {
+              if (msg.lane[k] > 0 && (depth[dst].lane[k]==UNVISITED || depth[dst].lane[k]==level+1)) {
+                depth[dst].lane[k] = level + 1;
+                write_add(&num_paths[dst].lane[k], msg.lane[k]);
+                active_out->set_bit(dst);
+              }
+            }
+          }
+          return 0;
+        },
+        [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+          PathLanes msg;
+          bool any = false;
+          for (int k=0;k<LANES;k++) {
+            msg.lane[k] = 0;
+          }
+          for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+            VertexId src = ptr->neighbour;
+            if (active_in->get_bit(src)) {
+              for (int k=0;k<LANES;k++) {
+                if (depth[src].lane[k]==level) {
+                  msg.lane[k] += num_paths[src].lane[k];
+                  any = true;
+                }
+              }
+            }
+          }
+          if (any) {
+            graph->emit(dst, msg);
+          }
+        },
+        [&](VertexId dst, PathLanes msg) {
+          for (int k=0;k<LANES;k++) {
+            if (msg.lane[k] > 0 && (depth[dst].lane[k]==UNVISITED || depth[dst].lane[k]==level+1)) {
+              depth[dst].lane[k] = level + 1;
+              write_add(&num_paths[dst].lane[k], msg.lane[k]);
+              active_out->set_bit(dst);
+            }
+          }
+          return 0;
+        },
+        active_in
+      );
+      active_vertices = graph->process_vertices<VertexId>(
+        [&](VertexId vtx) {
+          return 1;
+        },
+        active_out
+      );
+    }
+    // levels[0..level-1] are non-empty
+
+    // backward: dependencies[v] accumulates (1 + delta(v)) / num_paths(v), as in bc
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        for (int k=0;k<LANES;k++) {
+          dependencies[vtx].lane[k] = 0;
+        }
+        return 0;
+      },
+      active_all
+    );
+    graph->transpose();
+    for (unsigned l_i=level-1;;l_i--) {
+      graph->process_vertices<VertexId>(
+        [&](VertexId vtx) {
+          for (int k=0;k<LANES;k++) {
+            if (depth[vtx].lane[k]==l_i) {
+              dependencies[vtx].lane[k] += 1 / num_paths[vtx].lane[k];
+            }
+          }
+          return 1;
+        },
+        levels[l_i]
+      );
+      if (l_i==0) break;
+      VertexSubset * active_in = levels[l_i];
+      graph->process_edges<VertexId,PathLanes>(
+        [&](VertexId src){
+          PathLanes msg;
+          for (int k=0;k<LANES;k++) {
+            msg.lane[k] = depth[src].lane[k]==l_i ? dependencies[src].lane[k] : 0;
+          }
+          graph->emit(src, msg);
+        },
+        [&](VertexId src, PathLanes msg, VertexAdjList<Empty> outgoing_adj){
+          for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+            VertexId dst = ptr->neighbour;
+            for (int k=0;k<LANES;k++) {
+              if (msg.lane[k] > 0 && depth[dst].lane[k]==l_i-1) {
+                write_add(&dependencies[dst].lane[k], msg.lane[k]);
+              }
+            }
+          }
+          return 0;
+        },
+        [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+          PathLanes msg;
+          bool any = false;
+          for (int k=0;k<LANES;k++) {
+            msg.lane[k] = 0;
+          }
+          for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+            VertexId src = ptr->neighbour;
+            if (active_in->get_bit(src)) {
+              for (int k=0;k<LANES;k++) {
+                if (depth[src].lane[k]==l_i) {
+                  msg.lane[k] += dependencies[src].lane[k];
+                  any = true;
+                }
+              }
+            }
+          }
+          if (any) {
+            graph->emit(dst, msg);
+          }
+        },
+        [&](VertexId dst, PathLanes msg) {
+          for (int k=0;k<LANES;k++) {
+            if (msg.lane[k] > 0 && depth[dst].lane[k]==l_i-1) {
+              write_add(&dependencies[dst].lane[k], msg.lane[k]);
+            }
+          }
+          return 0;
+        },
+        active_in
+      );
+    }
+    graph->transpose();
+
+    // delta(v) = (dependencies(v) - 1 / num_paths(v)) * num_paths(v); roots do not count towards their own BC
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        for (size_t k=0;k<batch_size;k++) {
+          unsigned d = depth[vtx].lane[k];
+          if (d!=UNVISITED && d>0) {
+            double paths = num_paths[vtx].lane[k];
+            centrality[vtx] += (dependencies[vtx].lane[k] * paths - 1) * weight[batch_begin + k];
+          }
+        }
+        return 1;
+      },
+      active_all
+    );
+    if (graph->partition_id==0) {
+      printf("batch(%lu) depth=%u\n", batch_begin / LANES, level);
+    }
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+  }
+
+  std::pair<VertexId,double> max_centrality = graph->arg_max(centrality);
+  if (graph->partition_id==0) {
+    printf("bc[%lu]=%lf\n", max_centrality.first, max_centrality.second);
+  }
+
+  graph->dealloc_vertex_array(num_paths);
+  graph->dealloc_vertex_array(dependencies);
+  graph->dealloc_vertex_array(depth);
+  graph->dealloc_vertex_array(centrality);
+  for (size_t l_i=0;l_i<levels.size();l_i++) {
+    delete levels[l_i];
+  }
+  delete active_all;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<5) {
+    printf("bc_batch <threads> <file> <vertices> <samples> [uniform|degree] [seed]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+
+  VertexId vertices = std::strtoul(argv[3], &end, 10);
+  end = NULL;
+  graph->load_directed(argv[2], vertices);
+
+  VertexId samples = std::strtoul(argv[4], &end, 10);
+  std::string strategy = argc >= 6 ? argv[5] : "uniform";
+  unsigned seed = argc >= 7 ? std::atoi(argv[6]) : 0;
+  std::vector<VertexId> roots;
+  std::vector<double> weight;
+  sample_roots(graph, samples, strategy, seed, roots, weight);
+
+  compute(graph, roots, weight);
+  for (int run=0;run<5;run++) {
+    compute(graph, roots, weight);
+  }
+
+  delete graph;
+  return 0;
+}
@@ -92,14 +92,12 @@ void compute(Graph<Empty> * graph, VertexId root) {
     printf("exec_time=%lf(s)\n", exec_time);
   }
 
-  graph->gather_vertex_array(parent, 0);
-  if (graph->partition_id==0) {
-    VertexId found_vertices = 0;
-    for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
-      if (parent[v_i] < graph->vertices) {
-        found_vertices += 1;
-      }
+  VertexId found_vertices = graph->count_vertices(
+    [&](VertexId vtx) {
+      return parent[vtx] < graph->vertices;
     }
+  );
+  if (graph->partition_id==0) {
     printf("found_vertices = %lu\n", found_vertices);
   }
 
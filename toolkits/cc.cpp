@@ -19,7 +19,7 @@ Copyright (c) 2014-2015 Xiaowei Zhu, Tsinghua University
 
 #include "core/graph.hpp"
 
-void compute(Graph<Empty> * graph) {
+void compute(Graph<Empty> * graph, std::string output_path) {
   double exec_time = 0;
   exec_time -= get_time();
 
@@ -27,6 +27,7 @@ void compute(Graph<Empty> * graph) {
   VertexSubset * active_in = graph->alloc_vertex_subset();
   active_in->fill();
   VertexSubset * active_out = graph->alloc_vertex_subset();
+  Accumulator<VertexId, MinReduction<VertexId>> * lowered = graph->alloc_accumulator<VertexId, MinReduction<VertexId>>();
 
   VertexId active_vertices = graph->process_vertices<VertexId>(
     [&](VertexId vtx){
@@ -46,16 +47,13 @@ void compute(Graph<Empty> * graph) {
         graph->emit(src, label[src]);
       },
       [&](VertexId src, VertexId msg, VertexAdjList<Empty> outgoing_adj){
-        VertexId activated = 0;
         for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
           VertexId dst = ptr->neighbour;
           if (msg < label[dst]) {
-            write_min(&label[dst], msg);
-            active_out->set_bit(dst);
-            activated += 1;
+            lowered->add(dst, msg);
           }
         }
-        return activated;
+        return 0u;
       },
       [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
         VertexId msg = dst;
@@ -79,6 +77,7 @@ void compute(Graph<Empty> * graph) {
       },
       active_in
     );
+    active_vertices += lowered->flush(label, active_out);
     std::swap(active_in, active_out);
   }
 
@@ -87,25 +86,24 @@ void compute(Graph<Empty> * graph) {
     printf("exec_time=%lf(s)\n", exec_time);
   }
 
-  graph->gather_vertex_array(label, 0);
-  if (graph->partition_id==0) {
-    VertexId * count = graph->alloc_vertex_array<VertexId>();
-    graph->fill_vertex_array(count, 0lu);
-    for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
-      count[label[v_i]] += 1;
-    }
-    VertexId components = 0;
-    for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
-      if (count[v_i] > 0) {
-        components += 1;
-      }
+  if (output_path!="") {
+    graph->dump_vertex_array(label, output_path);
+  }
+
+  // every component is labelled with its lowest vertex id
+  VertexId components = graph->count_vertices(
+    [&](VertexId vtx) {
+      return label[vtx] == vtx;
     }
+  );
+  if (graph->partition_id==0) {
     printf("components = %lu\n", components);
   }
   
   graph->dealloc_vertex_array(label);
   delete active_in;
   delete active_out;
+  delete lowered;
 }
 
 int main(int argc, char ** argv) {
@@ -114,7 +112,7 @@ int main(int argc, char ** argv) {
   int threads;
 
   if (argc<4) {
-    printf("cc [threads] [file] [vertices]\n");
+    printf("cc [threads] [file] [vertices] [output] [symmetric]\n");
     exit(-1);
   }
 
@@ -124,11 +122,19 @@ int main(int argc, char ** argv) {
   Graph<Empty> * graph;
   graph = new Graph<Empty>(threads);
   //graph->load_undirected_from_directed(argv[1], std::atoi(argv[2]));
-  graph->load_undirected_from_directed(argv[2], std::strtoul(argv[3], &end, 10));
+  // a file that already lists both directions of every edge is stored as it is
+  bool symmetric = argc >= 6 && std::atoi(argv[5])!=0;
+  if (symmetric) {
+    graph->load_symmetric(argv[2], std::strtoul(argv[3], &end, 10));
+  } else {
+    graph->load_undirected_from_directed(argv[2], std::strtoul(argv[3], &end, 10));
+  }
+
+  std::string output_path = argc >= 5 ? argv[4] : "";
 
-  compute(graph);
+  compute(graph, output_path);
   for (int run=0;run<5;run++) {
-    compute(graph);
+    compute(graph, output_path);
   }
 
   delete graph;
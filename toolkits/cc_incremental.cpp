@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2014-2015 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/graph.hpp"
+
+void compute(Graph<Empty> * graph, std::string prev_path, std::string batch_path, std::string output_path) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  VertexId * label = graph->alloc_vertex_array<VertexId>();
+  VertexSubset * active_in = graph->alloc_vertex_subset();
+  VertexSubset * active_out = graph->alloc_vertex_subset();
+
+  graph->restore_vertex_array(label, prev_path);
+
+  // labels only decrease under edge insertions, so propagation can restart from the endpoints of the batch
+  VertexId begin_v_i = graph->partition_offset[graph->partition_id];
+  VertexId end_v_i = graph->partition_offset[graph->partition_id+1];
+  std::vector<EdgeUnit<Empty> > batch = read_edge_batch<Empty>(batch_path);
+  active_in->clear();
+  for (size_t e_i=0;e_i<batch.size();e_i++) {
+    VertexId src = batch[e_i].src;
+    VertexId dst = batch[e_i].dst;
+    if (src >= begin_v_i && src < end_v_i) {
+      active_in->set_bit(src);
+    }
+    if (dst >= begin_v_i && dst < end_v_i) {
+      active_in->set_bit(dst);
+    }
+  }
+  VertexId active_vertices = graph->process_vertices<VertexId>(
+    [&](VertexId vtx){
+      return 1;
+    },
+    active_in
+  );
+
+  for (int i_i=0;active_vertices>0;i_i++) {
+    if (graph->partition_id==0) {
+      printf("active(%d)>=%lu\n", i_i, active_vertices);
+    }
+    active_out->clear();
+    active_vertices = graph->process_edges<VertexId,VertexId>(
+      [&](VertexId src){
+        graph->emit(src, label[src]);
+      },
+      [&](VertexId src, VertexId msg, VertexAdjList<Empty> outgoing_adj){
+        VertexId activated = 0;
+        for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          VertexId dst = ptr->neighbour;
+          if (msg < label[dst]) {
+            write_min(&label[dst], msg);
+            active_out->set_bit(dst);
+            activated += 1;
+          }
+        }
+        return activated;
+      },
+      [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+        VertexId msg = dst;
+        for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          VertexId src = ptr->neighbour;
+          if (label[src] < msg) {
+            msg = label[src];
+          }
+        }
+        if (msg < dst) {
+          graph->emit(dst, msg);
+        }
+      },
+      [&](VertexId dst, VertexId msg) {
+        if (msg < label[dst]) {
+          write_min(&label[dst], msg);
+          active_out->set_bit(dst);
+          return 1u;
+        }
+        return 0u;
+      },
+      active_in
+    );
+    std::swap(active_in, active_out);
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+  }
+
+  if (output_path!="") {
+    graph->dump_vertex_array(label, output_path);
+  }
+
+  // every component is labelled with its lowest vertex id
+  VertexId components = graph->count_vertices(
+    [&](VertexId vtx) {
+      return label[vtx] == vtx;
+    }
+  );
+  if (graph->partition_id==0) {
+    printf("components = %lu\n", components);
+  }
+
+  graph->dealloc_vertex_array(label);
+  delete active_in;
+  delete active_out;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<6) {
+    printf("cc_incremental [threads] [file] [vertices] [prev_labels] [inserted_edges] [output]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+  graph->load_undirected_from_directed(argv[2], std::strtoul(argv[3], &end, 10));
+  std::string output_path = argc >= 7 ? argv[6] : "";
+
+  compute(graph, argv[4], argv[5], output_path);
+
+  delete graph;
+  return 0;
+}
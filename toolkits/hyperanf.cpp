@@ -0,0 +1,246 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "core/graph.hpp"
+
+// log2 of the registers per counter; 7 gives 128 registers (a relative standard error of about 9%)
+#ifndef HLL_BITS
+#define HLL_BITS 7
+#endif
+#define HLL_REGISTERS (1 << HLL_BITS)
+
+// a HyperLogLog counter: register r holds the highest rank (position of the first set bit) among the
+// hashes of the counted vertices whose top HLL_BITS bits equal r
+struct HllCounter {
+  unsigned char reg[HLL_REGISTERS];
+  bool operator!=(const HllCounter & other) const {
+    return memcmp(reg, other.reg, HLL_REGISTERS)!=0;
+  }
+};
+
+// the union of two counters is their register-wise maximum
+struct HllUnion : UserReduction {
+  static HllCounter identity() {
+    HllCounter a;
+    memset(a.reg, 0, HLL_REGISTERS);
+    return a;
+  }
+  static void combine(HllCounter & a, const HllCounter & b) {
+    int r_i = 0;
+    #ifdef __AVX2__
+    for (;r_i+32<=HLL_REGISTERS;r_i+=32) {
+      __m256i block_a = _mm256_loadu_si256((const __m256i *)(a.reg + r_i));
+      __m256i block_b = _mm256_loadu_si256((const __m256i *)(b.reg + r_i));
+      _mm256_storeu_si256((__m256i *)(a.reg + r_i), _mm256_max_epu8(block_a, block_b));
+    }
+    #endif
+    for (;r_i<HLL_REGISTERS;r_i++) {
+      a.reg[r_i] = std::max(a.reg[r_i], b.reg[r_i]);
+    }
+  }
+};
+
+inline unsigned long mix_hash(unsigned long x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+inline void hll_add(HllCounter & a, VertexId vtx, unsigned long seed) {
+  unsigned long hash = mix_hash(vtx ^ mix_hash(seed));
+  int r_i = hash >> (64 - HLL_BITS);
+  unsigned long rest = hash << HLL_BITS;
+  unsigned char rank = rest==0 ? 64 - HLL_BITS + 1 : __builtin_clzl(rest) + 1;
+  a.reg[r_i] = std::max(a.reg[r_i], rank);
+}
+
+// the raw HyperLogLog estimate, with linear counting for small cardinalities
+inline double hll_estimate(const HllCounter & a) {
+  const double m = HLL_REGISTERS;
+  double alpha = m==16 ? 0.673 : m==32 ? 0.697 : m==64 ? 0.709 : 0.7213 / (1 + 1.079 / m);
+  double sum = 0;
+  int zeros = 0;
+  for (int r_i=0;r_i<HLL_REGISTERS;r_i++) {
+    sum += ldexp(1.0, -a.reg[r_i]);
+    zeros += a.reg[r_i]==0;
+  }
+  double estimate = alpha * m * m / sum;
+  if (estimate <= 2.5 * m && zeros > 0) {
+    estimate = m * log(m / zeros);
+  }
+  return estimate;
+}
+
+void compute(Graph<Empty> * graph, unsigned long seed, std::string output_path) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  // after round t, counter[v] counts the vertices with a path of at most t edges to v
+  HllCounter * counter = graph->alloc_vertex_array<HllCounter>();
+  double * estimate = graph->alloc_vertex_array<double>();
+  double * harmonic = graph->alloc_vertex_array<double>();
+  VertexSubset * active_in = graph->alloc_vertex_subset();
+  VertexSubset * active_out = graph->alloc_vertex_subset();
+  Accumulator<HllCounter, HllUnion> * unions = graph->alloc_accumulator<HllCounter, HllUnion>();
+
+  active_in->fill();
+  std::vector<double> neighbourhood;
+  neighbourhood.push_back(graph->process_vertices<double>(
+    [&](VertexId vtx) {
+      counter[vtx] = HllUnion::identity();
+      hll_add(counter[vtx], vtx, seed);
+      estimate[vtx] = hll_estimate(counter[vtx]);
+      harmonic[vtx] = 0;
+      return estimate[vtx];
+    },
+    active_in
+  ));
+  if (graph->partition_id==0) {
+    printf("N(0)=%.0lf\n", neighbourhood[0]);
+  }
+
+  // a counter only grows if one of its in-neighbours' counters grew in the previous round
+  VertexId active_vertices = graph->vertices;
+  for (int t=1;active_vertices>0;t++) {
+    active_out->clear();
+    graph->process_edges<VertexId,HllCounter>(
+      [&](VertexId src) {
+        graph->emit(src, counter[src]);
+      },
+      [&](VertexId src, HllCounter msg, VertexAdjList<Empty> outgoing_adj) {
+        for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          unions->add(ptr->neighbour, msg);
+        }
+        return 0;
+      },
+      [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+        HllCounter msg = HllUnion::identity();
+        bool any = false;
+        for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          VertexId src = ptr->neighbour;
+          if (active_in->get_bit(src)) {
+            HllUnion::combine(msg, counter[src]);
+            any = true;
+          }
+        }
+        if (any) {
+          graph->emit(dst, msg);
+        }
+      },
+      [&](VertexId dst, HllCounter msg) {
+        unions->add(dst, msg);
+        return 0;
+      },
+      active_in
+    );
+    active_vertices = unions->flush(counter, active_out);
+    if (active_vertices==0) break;
+    // harmonic centrality adds 1/t for every vertex first counted in round t
+    double grown = graph->process_vertices<double>(
+      [&](VertexId vtx) {
+        double next_estimate = hll_estimate(counter[vtx]);
+        double delta = next_estimate - estimate[vtx];
+        harmonic[vtx] += delta / t;
+        estimate[vtx] = next_estimate;
+        return delta;
+      },
+      active_out
+    );
+    neighbourhood.push_back(neighbourhood.back() + grown);
+    if (graph->partition_id==0) {
+      printf("N(%d)=%.0lf (%lu counters grew)\n", t, neighbourhood.back(), active_vertices);
+    }
+    std::swap(active_in, active_out);
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+  }
+
+  if (output_path!="") {
+    graph->dump_vertex_array(harmonic, output_path);
+  }
+
+  // the effective diameter is the (interpolated) distance within which 90% of the reachable pairs lie; it is 0 if the
+  // vertices themselves already make up that share (e.g. mostly isolated ones)
+  int rounds = neighbourhood.size() - 1;
+  double target = 0.9 * neighbourhood.back();
+  double effective_diameter = 0;
+  for (int t=1;t<=rounds && neighbourhood[0] < target;t++) {
+    if (neighbourhood[t] >= target) {
+      double step = neighbourhood[t] - neighbourhood[t-1];
+      effective_diameter = step > 0 ? t - 1 + (target - neighbourhood[t-1]) / step : t;
+      break;
+    }
+  }
+  std::pair<VertexId,double> central = graph->arg_max(harmonic);
+  if (graph->partition_id==0) {
+    printf("rounds = %d\n", rounds);
+    printf("reachable pairs = %.0lf\n", neighbourhood.back());
+    printf("effective diameter = %.2lf\n", effective_diameter);
+    printf("max harmonic centrality = %.2lf (vertex %lu)\n", central.second, central.first);
+  }
+
+  graph->dealloc_vertex_array(counter);
+  graph->dealloc_vertex_array(estimate);
+  graph->dealloc_vertex_array(harmonic);
+  delete active_in;
+  delete active_out;
+  delete unions;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<4) {
+    printf("hyperanf [threads] [file] [vertices] [seed] [output]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+  graph->load_directed(argv[2], std::strtoul(argv[3], &end, 10));
+
+  unsigned long seed = argc >= 5 ? std::strtoul(argv[4], &end, 10) : 0;
+  std::string output_path = argc >= 6 ? argv[5] : "";
+
+  compute(graph, seed, output_path);
+  for (int run=0;run<5;run++) {
+    compute(graph, seed, output_path);
+  }
+
+  delete graph;
+  return 0;
+}
@@ -0,0 +1,271 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "core/graph.hpp"
+
+// levels covered by the buckets at a time; vertices of higher degree wait until the window moves up to them
+#define PEEL_BUCKETS 128
+
+// owned live vertices by degree, for the levels [base, base + PEEL_BUCKETS); a vertex is added again whenever
+// its degree drops into the window, and outdated entries are skipped when their bucket is emptied
+class PeelBuckets {
+  Graph<Empty> * graph;
+  VertexId * degree;
+  VertexSubset * live;
+  std::vector<VertexId> * buckets; // [threads * PEEL_BUCKETS]
+public:
+  VertexId base;
+  PeelBuckets(Graph<Empty> * graph, VertexId * degree, VertexSubset * live) : graph(graph), degree(degree), live(live), base(0) {
+    buckets = new std::vector<VertexId> [graph->threads * PEEL_BUCKETS];
+  }
+  ~PeelBuckets() {
+    delete [] buckets;
+  }
+  // called by any thread while vertices are processed
+  void insert(VertexId vtx) {
+    if (degree[vtx] >= base && degree[vtx] < base + PEEL_BUCKETS) {
+      buckets[omp_get_thread_num() * PEEL_BUCKETS + degree[vtx] - base].push_back(vtx);
+    }
+  }
+  // collective; moves the window to start at the lowest degree of a live vertex and fills it
+  void rebuild() {
+    for (int b_i=0;b_i<graph->threads*PEEL_BUCKETS;b_i++) {
+      buckets[b_i].clear();
+    }
+    // like next_level, a rank without live vertices contributes graph->vertices (above any degree of the simple
+    // graph) rather than the identity of MinReduction
+    base = graph->vertices;
+    #pragma omp parallel for reduction(min:base)
+    for (VertexId v_i=graph->partition_offset[graph->partition_id];v_i<graph->partition_offset[graph->partition_id+1];v_i++) {
+      if (live->get_bit(v_i)) {
+        base = std::min(base, degree[v_i]);
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &base, 1, get_mpi_data_type<VertexId>(), MPI_MIN, MPI_COMM_WORLD);
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        insert(vtx);
+        return 0;
+      },
+      live
+    );
+  }
+  // collective; the lowest level from current on that some rank has a live vertex for, or graph->vertices
+  // if the window holds none
+  VertexId next_level(VertexId current) {
+    VertexId level = graph->vertices;
+    for (VertexId l_i=std::max(current, base);l_i<base+PEEL_BUCKETS && level==graph->vertices;l_i++) {
+      for (int t_i=0;t_i<graph->threads && level==graph->vertices;t_i++) {
+        for (VertexId vtx : buckets[t_i * PEEL_BUCKETS + l_i - base]) {
+          if (live->get_bit(vtx) && degree[vtx]==l_i) {
+            level = l_i;
+            break;
+          }
+        }
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &level, 1, get_mpi_data_type<VertexId>(), MPI_MIN, MPI_COMM_WORLD);
+    return level;
+  }
+  // sets the bits of the live vertices at level in frontier and empties its buckets
+  void extract(VertexId level, VertexSubset * frontier) {
+    #pragma omp parallel for
+    for (int t_i=0;t_i<graph->threads;t_i++) {
+      std::vector<VertexId> & bucket = buckets[t_i * PEEL_BUCKETS + level - base];
+      for (VertexId vtx : bucket) {
+        if (live->get_bit(vtx) && degree[vtx]==level) {
+          frontier->set_bit(vtx);
+        }
+      }
+      bucket.clear();
+    }
+  }
+};
+
+void compute(Graph<Empty> * graph, std::string output_path) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  VertexId * degree = graph->alloc_vertex_array<VertexId>();
+  VertexId * removed = graph->alloc_vertex_array<VertexId>();
+  VertexId * core = graph->alloc_vertex_array<VertexId>();
+  VertexSubset * live = graph->alloc_vertex_subset();
+  VertexSubset * active_in = graph->alloc_vertex_subset();
+  VertexSubset * active_out = graph->alloc_vertex_subset();
+  Accumulator<VertexId, SumReduction<VertexId>> * lost = graph->alloc_accumulator<VertexId>();
+
+  live->fill();
+  graph->process_vertices<VertexId>(
+    [&](VertexId vtx) {
+      degree[vtx] = graph->out_degree[vtx];
+      removed[vtx] = 0;
+      return 0;
+    },
+    live
+  );
+  PeelBuckets buckets(graph, degree, live);
+  buckets.rebuild();
+
+  VertexId level = 0;
+  int levels = 0;
+  for (VertexId live_vertices=graph->vertices;live_vertices>0;) {
+    level = buckets.next_level(level);
+    if (level==graph->vertices) {
+      buckets.rebuild();
+      level = buckets.base;
+      continue;
+    }
+    levels += 1;
+    active_in->clear();
+    buckets.extract(level, active_in);
+    // peel the level: whoever drops to it while its neighbours leave joins the next round of the same level
+    VertexId active_vertices = graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        return 1;
+      },
+      active_in
+    );
+    while (active_vertices > 0) {
+      live_vertices -= active_vertices;
+      graph->process_vertices<VertexId>(
+        [&](VertexId vtx) {
+          core[vtx] = level;
+          live->clear_bit(vtx);
+          return 0;
+        },
+        active_in
+      );
+      active_out->clear();
+      graph->process_edges<VertexId,VertexId>(
+        [&](VertexId src){
+          graph->emit(src, (VertexId)1);
+        },
+        [&](VertexId src, VertexId msg, VertexAdjList<Empty> outgoing_adj){
+          for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+            VertexId dst = ptr->neighbour;
+            if (live->get_bit(dst)) {
+              lost->add(dst, 1);
+            }
+          }
+          return 0;
+        },
+        [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+          if (!live->get_bit(dst)) return;
+          VertexId msg = 0;
+          for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+            VertexId src = ptr->neighbour;
+            if (active_in->get_bit(src)) {
+              msg += 1;
+            }
+          }
+          if (msg > 0) {
+            graph->emit(dst, msg);
+          }
+        },
+        [&](VertexId dst, VertexId msg) {
+          write_add(&removed[dst], msg);
+          active_out->set_bit(dst);
+          return 0;
+        },
+        active_in, live
+      );
+      lost->flush(removed, active_out);
+      active_in->clear();
+      active_vertices = graph->process_vertices<VertexId>(
+        [&](VertexId vtx) {
+          degree[vtx] -= std::min(degree[vtx], removed[vtx]);
+          removed[vtx] = 0;
+          if (degree[vtx] <= level) {
+            active_in->set_bit(vtx);
+            return 1;
+          }
+          buckets.insert(vtx);
+          return 0;
+        },
+        active_out
+      );
+    }
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+  }
+
+  if (output_path!="") {
+    graph->dump_vertex_array(core, output_path);
+  }
+
+  VertexId max_core = graph->arg_max(core).second;
+  std::vector<VertexId> sizes = graph->histogram(
+    [&](VertexId vtx) {
+      return (long)core[vtx];
+    },
+    max_core + 1
+  );
+  if (graph->partition_id==0) {
+    printf("peeled levels = %d\n", levels);
+    printf("max core = %lu (%lu vertices)\n", max_core, sizes[max_core]);
+  }
+
+  graph->dealloc_vertex_array(degree);
+  graph->dealloc_vertex_array(removed);
+  graph->dealloc_vertex_array(core);
+  delete live;
+  delete active_in;
+  delete active_out;
+  delete lost;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<4) {
+    printf("kcore [threads] [file] [vertices] [output] [symmetric]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+  // coreness is defined on simple graphs
+  graph->sort_adjacency_on_load(true);
+  bool symmetric = argc >= 6 && std::atoi(argv[5])!=0;
+  if (symmetric) {
+    graph->load_symmetric(argv[2], std::strtoul(argv[3], &end, 10));
+  } else {
+    graph->load_undirected_from_directed(argv[2], std::strtoul(argv[3], &end, 10));
+  }
+
+  std::string output_path = argc >= 5 ? argv[4] : "";
+
+  compute(graph, output_path);
+  for (int run=0;run<5;run++) {
+    compute(graph, output_path);
+  }
+
+  delete graph;
+  return 0;
+}
@@ -0,0 +1,415 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "core/graph.hpp"
+
+// the graphs of the coarser levels; a self-loop of a community carries twice its internal weight
+typedef double Weight;
+
+// a level stops moving vertices after this many sweeps, or once a sweep raises the modularity by less than this
+#define MAX_SWEEPS 32
+#define MIN_GAIN 1e-6
+// with several ranks, the number of classes of vertices that move one after another within a sweep
+#define COLOURS 4
+
+inline Weight edge_weight(const AdjUnit<Empty> & edge) {
+  return 1;
+}
+
+inline Weight edge_weight(const AdjUnit<Weight> & edge) {
+  return edge.edge_data;
+}
+
+// the class in which vtx moves during the given sweep
+inline int colour_of(VertexId vtx, int sweep, int colours) {
+  unsigned long x = vtx ^ ((unsigned long)sweep << 40);
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x % colours;
+}
+
+// one level of Louvain on graph (undirected, with weight 1 per edge unless EdgeData carries it): vertices move
+// between communities until few do, then coarse_id[v] receives the community of every vertex v, renumbered from 0,
+// and the graph of the communities is returned (nullptr if no vertex was merged)
+template <typename EdgeData>
+Graph<Weight> * run_level(Graph<EdgeData> * graph, int level, std::vector<VertexId> & coarse_id, VertexId & communities, double & modularity) {
+  double level_time = 0;
+  level_time -= get_time();
+
+  VertexId begin_v_i = graph->partition_offset[graph->partition_id];
+  VertexId end_v_i = graph->partition_offset[graph->partition_id+1];
+  VertexId owned_vertices = end_v_i - begin_v_i;
+  std::vector<EdgeId> index;
+  std::vector<AdjUnit<EdgeData> > adj;
+  graph->transpose_owned_adjacency(index, adj);
+
+  // community[], total[] (weighted degree of each community) and size[] are complete on every rank and identical
+  // after each sweep, whose moves are exchanged and applied everywhere
+  VertexId * community = graph->template alloc_vertex_array<VertexId>();
+  VertexId * size = graph->template alloc_vertex_array<VertexId>();
+  Weight * degree = graph->template alloc_vertex_array<Weight>();
+  Weight * total = graph->template alloc_vertex_array<Weight>();
+  #pragma omp parallel for
+  for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+    community[v_i] = v_i;
+    size[v_i] = 1;
+    degree[v_i] = 0;
+  }
+  #pragma omp parallel for
+  for (VertexId v_i=0;v_i<owned_vertices;v_i++) {
+    for (EdgeId e_i=index[v_i];e_i<index[v_i+1];e_i++) {
+      degree[begin_v_i + v_i] += edge_weight(adj[e_i]);
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, degree, graph->vertices, get_mpi_data_type<Weight>(), MPI_SUM, MPI_COMM_WORLD);
+  Weight total_weight = 0; // 2m
+  #pragma omp parallel for reduction(+:total_weight)
+  for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+    total[v_i] = degree[v_i];
+    total_weight += degree[v_i];
+  }
+
+  auto move = [&](VertexId vtx, VertexId to) {
+    VertexId from = community[vtx];
+    write_add(&total[from], -degree[vtx]);
+    write_add(&total[to], degree[vtx]);
+    write_add(&size[from], (VertexId)-1);
+    write_add(&size[to], (VertexId)1);
+    community[vtx] = to;
+  };
+
+  // Q = sum over communities of internal / 2m - (total / 2m)^2, where internal counts both directions of an edge
+  VertexSubset * owned = graph->alloc_vertex_subset();
+  owned->fill();
+  auto current_modularity = [&]() {
+    Weight internal = graph->template process_vertices<Weight>(
+      [&](VertexId vtx) {
+        VertexId v_i = vtx - begin_v_i;
+        Weight sum = 0;
+        for (EdgeId e_i=index[v_i];e_i<index[v_i+1];e_i++) {
+          if (community[adj[e_i].neighbour]==community[vtx]) {
+            sum += edge_weight(adj[e_i]);
+          }
+        }
+        return sum;
+      },
+      owned
+    );
+    Weight squares = graph->template process_vertices<Weight>(
+      [&](VertexId vtx) {
+        return total[vtx] * total[vtx];
+      },
+      owned
+    );
+    return internal / total_weight - squares / total_weight / total_weight;
+  };
+  modularity = current_modularity();
+
+  std::vector<VertexTable<Weight> > tables(graph->threads);
+  VertexSubset * pending = graph->alloc_vertex_subset();
+  VertexSubset * changed = graph->alloc_vertex_subset();
+  pending->fill();
+  std::vector<std::vector<VertexId> > thread_moves(graph->threads);
+  std::vector<VertexId> moves;
+  std::vector<VertexId> all_moves;
+  std::vector<int> counts(graph->partitions);
+  std::vector<int> displs(graph->partitions);
+
+  int colours = graph->partitions > 1 ? COLOURS : 1;
+  int sweeps = 0;
+  VertexId total_moved = 0;
+  while (sweeps < MAX_SWEEPS) {
+    sweeps += 1;
+    // every pending vertex moves to the community of highest gain. With several ranks the vertices move class by
+    // class, each class exchanging its moves before the next one decides, so that a vertex only misses the moves of
+    // its own class made on other ranks; the classes change with every sweep, or two such neighbours could keep
+    // following each other. Moves take effect on this rank at once, and a singleton joins another singleton only if
+    // that one has a lower id, so that pairs split across threads or ranks cannot keep swapping
+    changed->clear();
+    VertexId moved = 0;
+    for (int c_i=0;c_i<colours;c_i++) {
+      VertexId class_moved = graph->template process_vertices<VertexId>(
+        [&](VertexId vtx) {
+          if (colours > 1 && colour_of(vtx, sweeps, colours)!=c_i) return 0;
+          VertexTable<Weight> & table = tables[omp_get_thread_num()];
+          VertexId v_i = vtx - begin_v_i;
+          table.reserve(index[v_i+1] - index[v_i]);
+          for (EdgeId e_i=index[v_i];e_i<index[v_i+1];e_i++) {
+            if (adj[e_i].neighbour!=vtx) {
+              table.add(community[adj[e_i].neighbour], edge_weight(adj[e_i]));
+            }
+          }
+          VertexId current = community[vtx];
+          double scale = degree[vtx] / total_weight;
+          VertexId best = current;
+          double best_gain = table.get(current) - (total[current] - degree[vtx]) * scale;
+          table.drain([&](VertexId c, Weight weight) {
+            if (c==current) return;
+            double gain = weight - total[c] * scale;
+            if (gain > best_gain || (gain==best_gain && best!=current && c < best)) {
+              best = c;
+              best_gain = gain;
+            }
+          });
+          if (best!=current && size[current]==1 && size[best]==1 && best > current) {
+            best = current;
+          }
+          if (best==current) return 0;
+          move(vtx, best);
+          changed->set_bit(vtx);
+          thread_moves[omp_get_thread_num()].push_back(vtx);
+          thread_moves[omp_get_thread_num()].push_back(best);
+          return 1;
+        },
+        pending
+      );
+      if (class_moved==0) continue;
+      moved += class_moved;
+
+      moves.clear();
+      for (int t_i=0;t_i<graph->threads;t_i++) {
+        moves.insert(moves.end(), thread_moves[t_i].begin(), thread_moves[t_i].end());
+        thread_moves[t_i].clear();
+      }
+      assert(moves.size() <= (size_t)INT_MAX);
+      int count = moves.size();
+      MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+      size_t all_count = 0;
+      for (int p_i=0;p_i<graph->partitions;p_i++) {
+        displs[p_i] = all_count;
+        all_count += counts[p_i];
+        assert(all_count <= (size_t)INT_MAX);
+      }
+      all_moves.resize(all_count);
+      MPI_Allgatherv(moves.data(), count, get_mpi_data_type<VertexId>(), all_moves.data(), counts.data(), displs.data(), get_mpi_data_type<VertexId>(), MPI_COMM_WORLD);
+      #pragma omp parallel for
+      for (size_t m_i=0;m_i<all_count;m_i+=2) {
+        if (m_i >= (size_t)displs[graph->partition_id] && m_i < (size_t)displs[graph->partition_id] + count) continue;
+        move(all_moves[m_i], all_moves[m_i+1]);
+      }
+    }
+    if (moved==0) break;
+    total_moved += moved;
+
+    double gain = current_modularity() - modularity;
+    modularity += gain;
+    // a sweep may also lower the modularity while moves made on different ranks settle; that is no sign of convergence
+    if (gain >= 0 && gain < MIN_GAIN) break;
+
+    // only the moved vertices and their neighbours are considered again
+    pending->clear();
+    graph->template process_edges<VertexId,VertexId>(
+      [&](VertexId src) {
+        graph->emit(src, (VertexId)1);
+      },
+      [&](VertexId src, VertexId msg, VertexAdjList<EdgeData> outgoing_adj) {
+        for (AdjUnit<EdgeData> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          pending->set_bit(ptr->neighbour);
+        }
+        return 0;
+      },
+      [&](VertexId dst, VertexAdjList<EdgeData> incoming_adj) {
+        for (AdjUnit<EdgeData> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          if (changed->get_bit(ptr->neighbour)) {
+            graph->emit(dst, (VertexId)1);
+            return;
+          }
+        }
+      },
+      [&](VertexId dst, VertexId msg) {
+        pending->set_bit(dst);
+        return 0;
+      },
+      changed
+    );
+    graph->template process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        pending->set_bit(vtx);
+        return 0;
+      },
+      changed
+    );
+  }
+
+  // communities are renumbered in the order of their ids, the same way on every rank
+  std::vector<VertexId> renumbered(graph->vertices);
+  communities = 0;
+  for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+    renumbered[v_i] = communities;
+    if (size[v_i] > 0) {
+      communities += 1;
+    }
+  }
+  coarse_id.resize(graph->vertices);
+  #pragma omp parallel for
+  for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+    coarse_id[v_i] = renumbered[community[v_i]];
+  }
+
+  // every stored edge becomes one between the communities of its endpoints (both directions are stored, so the
+  // result is symmetric again); repeats within this rank are merged before the load
+  Graph<Weight> * coarse = nullptr;
+  if (communities < graph->vertices) {
+    std::vector<EdgeUnit<Weight> > coarse_edges(index[owned_vertices]);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (VertexId v_i=0;v_i<owned_vertices;v_i++) {
+      VertexId src = coarse_id[begin_v_i + v_i];
+      for (EdgeId e_i=index[v_i];e_i<index[v_i+1];e_i++) {
+        coarse_edges[e_i].src = src;
+        coarse_edges[e_i].dst = coarse_id[adj[e_i].neighbour];
+        coarse_edges[e_i].edge_data = edge_weight(adj[e_i]);
+      }
+    }
+    std::sort(coarse_edges.begin(), coarse_edges.end(), [](const EdgeUnit<Weight> & a, const EdgeUnit<Weight> & b) {
+      return a.src < b.src || (a.src==b.src && a.dst < b.dst);
+    });
+    size_t merged = 0;
+    for (size_t e_i=0;e_i<coarse_edges.size();e_i++) {
+      if (merged > 0 && coarse_edges[merged-1].src==coarse_edges[e_i].src && coarse_edges[merged-1].dst==coarse_edges[e_i].dst) {
+        coarse_edges[merged-1].edge_data += coarse_edges[e_i].edge_data;
+      } else {
+        coarse_edges[merged++] = coarse_edges[e_i];
+      }
+    }
+    coarse_edges.resize(merged);
+    std::vector<AdjUnit<EdgeData> >().swap(adj);
+    coarse = new Graph<Weight>(graph->threads);
+    coarse->load_symmetric_from_edges(coarse_edges, communities);
+  }
+
+  level_time += get_time();
+  if (graph->partition_id==0) {
+    printf("level %d: %lu vertices, %d sweeps, %lu moves, %lu communities, modularity = %lf, %lf(s)\n", level, graph->vertices, sweeps, total_moved, communities, modularity, level_time);
+  }
+
+  graph->dealloc_vertex_array(community);
+  graph->dealloc_vertex_array(size);
+  graph->dealloc_vertex_array(degree);
+  graph->dealloc_vertex_array(total);
+  delete pending;
+  delete changed;
+  delete owned;
+  return coarse;
+}
+
+void compute(Graph<Empty> * graph, std::string output_path) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  // membership[v] follows each vertex of the input graph up the levels
+  VertexId * membership = graph->alloc_vertex_array<VertexId>();
+  VertexSubset * active = graph->alloc_vertex_subset();
+  active->fill();
+  graph->template process_vertices<VertexId>(
+    [&](VertexId vtx) {
+      membership[vtx] = vtx;
+      return 0;
+    },
+    active
+  );
+
+  std::vector<VertexId> coarse_id;
+  VertexId communities = graph->vertices;
+  double modularity = 0;
+  auto climb = [&]() {
+    graph->template process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        membership[vtx] = coarse_id[membership[vtx]];
+        return 0;
+      },
+      active
+    );
+  };
+  int level = 0;
+  Graph<Weight> * coarse = run_level(graph, level, coarse_id, communities, modularity);
+  climb();
+  while (coarse!=nullptr) {
+    level += 1;
+    Graph<Weight> * next = run_level(coarse, level, coarse_id, communities, modularity);
+    climb();
+    delete coarse;
+    coarse = next;
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+  }
+
+  if (output_path!="") {
+    graph->dump_vertex_array(membership, output_path);
+  }
+
+  std::vector<VertexId> sizes = graph->histogram(
+    [&](VertexId vtx) {
+      return (long)membership[vtx];
+    },
+    communities
+  );
+  VertexId largest = std::max_element(sizes.begin(), sizes.end()) - sizes.begin();
+  if (graph->partition_id==0) {
+    printf("levels = %d\n", level + 1);
+    printf("communities = %lu\n", communities);
+    printf("modularity = %lf\n", modularity);
+    printf("largest community = %lu (community %lu)\n", sizes[largest], largest);
+  }
+
+  graph->dealloc_vertex_array(membership);
+  delete active;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<4) {
+    printf("louvain [threads] [file] [vertices] [output] [symmetric]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+  bool symmetric = argc >= 6 && std::atoi(argv[5])!=0;
+  if (symmetric) {
+    graph->load_symmetric(argv[2], std::strtoul(argv[3], &end, 10));
+  } else {
+    graph->load_undirected_from_directed(argv[2], std::strtoul(argv[3], &end, 10));
+  }
+
+  std::string output_path = argc >= 5 ? argv[4] : "";
+
+  compute(graph, output_path);
+  for (int run=0;run<5;run++) {
+    compute(graph, output_path);
+  }
+
+  delete graph;
+  return 0;
+}
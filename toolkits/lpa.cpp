@@ -0,0 +1,239 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include <vector>
+
+#include "core/graph.hpp"
+
+// the most frequent label of a neighbourhood counted in table, keeping current on a tie and otherwise preferring
+// the lowest one, so that the result does not depend on the order of the neighbours; empties the table
+VertexId take_mode(VertexTable<VertexId> & table, VertexId current) {
+  VertexId best = current;
+  VertexId best_count = 0;
+  table.drain([&](VertexId label, VertexId count) {
+    if (count > best_count || (count==best_count && best!=current && (label==current || label < best))) {
+      best = label;
+      best_count = count;
+    }
+  });
+  return best;
+}
+
+// whether vtx may take a new label in the given iteration; about half of the vertices do, a different half each
+// time, since two neighbours relabelled together can swap their labels forever
+inline bool takes_turn(VertexId vtx, int iteration) {
+  unsigned long x = vtx ^ ((unsigned long)iteration << 40);
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x >> 63;
+}
+
+void compute(Graph<Empty> * graph, int iterations, std::string output_path) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  VertexId begin_v_i = graph->partition_offset[graph->partition_id];
+  std::vector<EdgeId> index;
+  std::vector<AdjUnit<Empty> > adj;
+  graph->transpose_owned_adjacency(index, adj);
+
+  // label[] is complete on every rank: entries of remote vertices mirror the labels of their owners and are
+  // refreshed whenever those change
+  VertexId * label = graph->alloc_vertex_array<VertexId>();
+  VertexId * next_label = graph->alloc_vertex_array<VertexId>();
+  #pragma omp parallel for
+  for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+    label[v_i] = v_i;
+  }
+  std::vector<VertexTable<VertexId> > counters(graph->threads);
+  VertexSubset * pending = graph->alloc_vertex_subset();
+  VertexSubset * changed = graph->alloc_vertex_subset();
+  VertexSubset * deferred = graph->alloc_vertex_subset();
+  pending->fill();
+
+  std::vector<int> counts(graph->partitions);
+  std::vector<int> displs(graph->partitions);
+  for (int p_i=0;p_i<graph->partitions;p_i++) {
+    assert(graph->partition_offset[p_i+1] - graph->partition_offset[p_i] <= (VertexId)INT_MAX);
+    counts[p_i] = graph->partition_offset[p_i+1] - graph->partition_offset[p_i];
+    displs[p_i] = graph->partition_offset[p_i];
+  }
+
+  int i_i = 0;
+  VertexId unsettled = 0;
+  for (;i_i<iterations;i_i++) {
+    // only vertices next to a changed label can change theirs; the others are skipped. A vertex whose turn it
+    // is not keeps its label and stays pending for the next iteration
+    changed->clear();
+    deferred->clear();
+    unsettled = graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        VertexTable<VertexId> & counter = counters[omp_get_thread_num()];
+        VertexId v_i = vtx - begin_v_i;
+        counter.reserve(index[v_i+1] - index[v_i]);
+        for (EdgeId e_i=index[v_i];e_i<index[v_i+1];e_i++) {
+          if (adj[e_i].neighbour!=vtx) {
+            counter.add(label[adj[e_i].neighbour], 1);
+          }
+        }
+        next_label[vtx] = take_mode(counter, label[vtx]);
+        if (next_label[vtx]==label[vtx]) {
+          return 0;
+        }
+        if (takes_turn(vtx, i_i)) {
+          changed->set_bit(vtx);
+        } else {
+          deferred->set_bit(vtx);
+        }
+        return 1;
+      },
+      pending
+    );
+    if (graph->partition_id==0) {
+      printf("unsettled(%d)=%lu\n", i_i, unsettled);
+    }
+    if (unsettled==0) break;
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        label[vtx] = next_label[vtx];
+        return 0;
+      },
+      changed
+    );
+
+    // a sparse step hands each new label to the partitions holding edges of its vertex; a dense one only
+    // finds the vertices next to a change, and the owned ranges of label[] are then exchanged as a whole
+    std::swap(pending, deferred);
+    int dense = 0;
+    graph->process_edges<VertexId,VertexId>(
+      [&](VertexId src) {
+        graph->emit(src, label[src]);
+      },
+      [&](VertexId src, VertexId msg, VertexAdjList<Empty> outgoing_adj) {
+        label[src] = msg;
+        for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          pending->set_bit(ptr->neighbour);
+        }
+        return 0;
+      },
+      [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+        dense = 1;
+        for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          if (changed->get_bit(ptr->neighbour)) {
+            graph->emit(dst, (VertexId)1);
+            return;
+          }
+        }
+      },
+      [&](VertexId dst, VertexId msg) {
+        pending->set_bit(dst);
+        return 0;
+      },
+      changed
+    );
+    MPI_Allreduce(MPI_IN_PLACE, &dense, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (dense && graph->partitions > 1) {
+      MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, label, counts.data(), displs.data(), get_mpi_data_type<VertexId>(), MPI_COMM_WORLD);
+    }
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+  }
+
+  if (output_path!="") {
+    graph->dump_vertex_array(label, output_path);
+  }
+
+  // next_label[] is reused for the size of each community
+  #pragma omp parallel for
+  for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+    next_label[v_i] = 0;
+  }
+  pending->fill();
+  graph->process_vertices<VertexId>(
+    [&](VertexId vtx) {
+      write_add(&next_label[label[vtx]], (VertexId)1);
+      return 0;
+    },
+    pending
+  );
+  MPI_Allreduce(MPI_IN_PLACE, next_label, graph->vertices, get_mpi_data_type<VertexId>(), MPI_SUM, MPI_COMM_WORLD);
+  VertexId communities = graph->count_vertices(
+    [&](VertexId vtx) {
+      return next_label[vtx] > 0;
+    }
+  );
+  std::pair<VertexId,VertexId> largest = graph->arg_max(next_label);
+  if (graph->partition_id==0) {
+    if (unsettled > 0) {
+      printf("stopped after %d iterations with %lu vertices still unsettled\n", i_i, unsettled);
+    } else {
+      printf("converged after %d iterations\n", i_i);
+    }
+    printf("communities = %lu\n", communities);
+    printf("largest community = %lu (label %lu)\n", largest.second, largest.first);
+  }
+
+  graph->dealloc_vertex_array(label);
+  graph->dealloc_vertex_array(next_label);
+  delete pending;
+  delete changed;
+  delete deferred;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<5) {
+    printf("lpa [threads] [file] [vertices] [iterations] [output] [symmetric]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+  bool symmetric = argc >= 7 && std::atoi(argv[6])!=0;
+  if (symmetric) {
+    graph->load_symmetric(argv[2], std::strtoul(argv[3], &end, 10));
+  } else {
+    graph->load_undirected_from_directed(argv[2], std::strtoul(argv[3], &end, 10));
+  }
+
+  int iterations = std::atoi(argv[4]);
+  assert(iterations > 0);
+  std::string output_path = argc >= 6 ? argv[5] : "";
+
+  compute(graph, iterations, output_path);
+  for (int run=0;run<5;run++) {
+    compute(graph, iterations, output_path);
+  }
+
+  delete graph;
+  return 0;
+}
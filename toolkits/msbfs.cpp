@@ -0,0 +1,250 @@
+/*
+Copyright (c) 2014-2015 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+
+#include "core/graph.hpp"
+
+// a source mask has one bit per source of the current batch, in a number of 64-bit words fixed for the run
+
+inline bool mask_empty(const unsigned long * a, int words) {
+  unsigned long any = 0;
+  for (int w_i=0;w_i<words;w_i++) {
+    any |= a[w_i];
+  }
+  return any==0;
+}
+
+inline void mask_clear(unsigned long * a, int words) {
+  for (int w_i=0;w_i<words;w_i++) {
+    a[w_i] = 0;
+  }
+}
+
+// a |= b
+inline void mask_or(unsigned long * a, const unsigned long * b, int words) {
+  for (int w_i=0;w_i<words;w_i++) {
+    a[w_i] |= b[w_i];
+  }
+}
+
+// c = a & ~b
+inline void mask_andnot(unsigned long * c, const unsigned long * a, const unsigned long * b, int words) {
+  for (int w_i=0;w_i<words;w_i++) {
+    c[w_i] = a[w_i] & ~b[w_i];
+  }
+}
+
+inline void mask_atomic_or(unsigned long * a, const unsigned long * b, int words) {
+  for (int w_i=0;w_i<words;w_i++) {
+    if (b[w_i] & ~a[w_i]) {
+      __sync_fetch_and_or(&a[w_i], b[w_i]);
+    }
+  }
+}
+
+void compute(Graph<Empty> * graph, std::vector<VertexId> & sources, int words) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  const size_t batch = 64 * words;
+  unsigned long * seen = graph->alloc_vertex_array<unsigned long>(words);
+  unsigned long * visit = graph->alloc_vertex_array<unsigned long>(words);
+  unsigned long * next = graph->alloc_vertex_array<unsigned long>(words);
+  VertexSubset * active_all = graph->alloc_vertex_subset();
+  active_all->fill();
+  VertexSubset * active_in = graph->alloc_vertex_subset();
+  VertexSubset * active_out = graph->alloc_vertex_subset();
+  // per-thread counters of reached vertices and distance sums, one per source of the batch, and a mask to work in
+  std::vector<VertexId> reached(graph->threads * batch);
+  std::vector<VertexId> distance_sum(graph->threads * batch);
+  std::vector<unsigned long> scratch(graph->threads * words);
+  std::vector<VertexId> batch_reached(batch);
+  std::vector<VertexId> batch_distance_sum(batch);
+
+  VertexId begin_v_i = graph->partition_offset[graph->partition_id];
+  VertexId end_v_i = graph->partition_offset[graph->partition_id+1];
+  VertexId total_reached = 0;
+  for (size_t batch_begin=0;batch_begin<sources.size();batch_begin+=batch) {
+    size_t batch_size = std::min(batch, sources.size() - batch_begin);
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        mask_clear(seen + vtx * words, words);
+        mask_clear(visit + vtx * words, words);
+        mask_clear(next + vtx * words, words);
+        return 0;
+      },
+      active_all
+    );
+    std::fill(reached.begin(), reached.end(), 0);
+    std::fill(distance_sum.begin(), distance_sum.end(), 0);
+    active_in->clear();
+    for (size_t s_i=0;s_i<batch_size;s_i++) {
+      VertexId src = sources[batch_begin + s_i];
+      if (src >= begin_v_i && src < end_v_i) {
+        seen[src * words + s_i / 64] |= 1ul << (s_i % 64);
+        visit[src * words + s_i / 64] |= 1ul << (s_i % 64);
+        active_in->set_bit(src);
+      }
+    }
+    VertexId active_vertices = 1;
+    for (VertexId level=1;active_vertices>0;level++) {
+      active_out->clear();
+      // marks the sources of msg that dst has not seen yet for the next level
+      auto discover = [&](VertexId dst, const unsigned long * msg) {
+        unsigned long * discovered = scratch.data() + omp_get_thread_num() * words;
+        mask_andnot(discovered, msg, seen + dst * words, words);
+        if (!mask_empty(discovered, words)) {
+          mask_atomic_or(next + dst * words, discovered, words);
+          active_out->set_bit(dst);
+        }
+      };
+      graph->process_edges_array<VertexId,unsigned long>(words,
+        [&](VertexId src){
+          graph->emit_array(src, visit + src * words);
+        },
+        [&](VertexId src, const unsigned long * msg, VertexAdjList<Empty> outgoing_adj){
+          for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+            discover(ptr->neighbour, msg);
+          }
+          return 0;
+        },
+        [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+          unsigned long * msg = scratch.data() + omp_get_thread_num() * words;
+          mask_clear(msg, words);
+          for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+            VertexId src = ptr->neighbour;
+            if (active_in->get_bit(src)) {
+              mask_or(msg, visit + src * words, words);
+            }
+          }
+          if (!mask_empty(msg, words)) {
+            graph->emit_array(dst, msg);
+          }
+        },
+        [&](VertexId dst, const unsigned long * msg) {
+          discover(dst, msg);
+          return 0;
+        },
+        active_in
+      );
+      graph->process_vertices<VertexId>(
+        [&](VertexId vtx) {
+          mask_clear(visit + vtx * words, words);
+          return 0;
+        },
+        active_in
+      );
+      active_vertices = graph->process_vertices<VertexId>(
+        [&](VertexId vtx) {
+          int t_i = omp_get_thread_num();
+          unsigned long * vtx_visit = visit + vtx * words;
+          mask_andnot(vtx_visit, next + vtx * words, seen + vtx * words, words);
+          mask_or(seen + vtx * words, vtx_visit, words);
+          mask_clear(next + vtx * words, words);
+          for (int w_i=0;w_i<words;w_i++) {
+            unsigned long word = vtx_visit[w_i];
+            while (word != 0) {
+              int s_i = w_i * 64 + __builtin_ctzl(word);
+              reached[t_i * batch + s_i] += 1;
+              distance_sum[t_i * batch + s_i] += level;
+              word &= word - 1;
+            }
+          }
+          return 1;
+        },
+        active_out
+      );
+      std::swap(active_in, active_out);
+    }
+
+    for (size_t s_i=0;s_i<batch_size;s_i++) {
+      batch_reached[s_i] = 0;
+      batch_distance_sum[s_i] = 0;
+      for (int t_i=0;t_i<graph->threads;t_i++) {
+        batch_reached[s_i] += reached[t_i * batch + s_i];
+        batch_distance_sum[s_i] += distance_sum[t_i * batch + s_i];
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, batch_reached.data(), batch_size, get_mpi_data_type<VertexId>(), MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, batch_distance_sum.data(), batch_size, get_mpi_data_type<VertexId>(), MPI_SUM, MPI_COMM_WORLD);
+    if (graph->partition_id==0) {
+      for (size_t s_i=0;s_i<batch_size;s_i++) {
+        batch_reached[s_i] += 1; // the source itself
+        printf("source %lu: reached = %lu, distance_sum = %lu\n", sources[batch_begin + s_i], batch_reached[s_i], batch_distance_sum[s_i]);
+        total_reached += batch_reached[s_i];
+      }
+    }
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+    printf("total_reached = %lu\n", total_reached);
+  }
+
+  graph->dealloc_vertex_array(seen);
+  graph->dealloc_vertex_array(visit);
+  graph->dealloc_vertex_array(next);
+  delete active_all;
+  delete active_in;
+  delete active_out;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<5) {
+    printf("msbfs <threads> <file> <vertices> <sources> [seed] [batch]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+
+  VertexId vertices = std::strtoul(argv[3], &end, 10);
+  end = NULL;
+  graph->load_directed(argv[2], vertices);
+
+  // every rank draws the same sources from the same seed
+  VertexId num_sources = std::strtoul(argv[4], &end, 10);
+  unsigned seed = argc >= 6 ? std::atoi(argv[5]) : 0;
+  // sources per batch, rounded up to whole mask words
+  int batch = argc >= 7 ? std::atoi(argv[6]) : 64;
+  assert(batch > 0);
+  int words = (batch + 63) / 64;
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<unsigned long> udist(0, vertices - 1);
+  std::vector<VertexId> sources;
+  for (VertexId s_i=0;s_i<num_sources;s_i++) {
+    sources.push_back(udist(gen));
+  }
+
+  compute(graph, sources, words);
+  for (int run=0;run<5;run++) {
+    compute(graph, sources, words);
+  }
+
+  delete graph;
+  return 0;
+}
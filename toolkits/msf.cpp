@@ -0,0 +1,254 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <limits>
+
+#include "core/graph.hpp"
+
+typedef float Weight;
+
+#define NO_VERTEX ((VertexId)-1)
+
+// an edge, ordered by weight and then by its lower and higher endpoints; the strict order keeps components that
+// see equally light edges from hooking into a cycle
+struct MinEdge {
+  Weight weight;
+  VertexId low;
+  VertexId high;
+  bool operator<(const MinEdge & other) const {
+    if (weight!=other.weight) return weight < other.weight;
+    if (low!=other.low) return low < other.low;
+    return high < other.high;
+  }
+  bool operator!=(const MinEdge & other) const {
+    return weight!=other.weight || low!=other.low || high!=other.high;
+  }
+};
+
+struct LighterEdge : UserReduction {
+  static MinEdge identity() {
+    return MinEdge{std::numeric_limits<Weight>::max(), NO_VERTEX, NO_VERTEX};
+  }
+  static void combine(MinEdge & a, const MinEdge & b) {
+    if (b < a) a = b;
+  }
+};
+
+inline MinEdge make_edge(VertexId u, VertexId v, Weight weight) {
+  return u < v ? MinEdge{weight, u, v} : MinEdge{weight, v, u};
+}
+
+void compute(Graph<Weight> * graph, std::string output_path) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  // component[] and parent[] are complete on every rank: each round ends with the lightest outgoing edge of every
+  // component on all of them, so that hooking, pointer jumping and relabelling need no further messages
+  VertexId * component = graph->alloc_vertex_array<VertexId>();
+  VertexId * parent = graph->alloc_vertex_array<VertexId>();
+  MinEdge * lightest = graph->alloc_vertex_array<MinEdge>();
+  MinEdge * best = graph->alloc_vertex_array<MinEdge>();
+  VertexSubset * active = graph->alloc_vertex_subset();
+  Accumulator<MinEdge, LighterEdge> * lighter = graph->alloc_accumulator<MinEdge, LighterEdge>();
+  #pragma omp parallel for
+  for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+    component[v_i] = v_i;
+  }
+  active->fill();
+
+  std::vector<MinEdge> forest;
+  double forest_weight = 0;
+  int rounds = 0;
+  while (true) {
+    // the lightest edge from each active vertex to another component
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        lightest[vtx] = LighterEdge::identity();
+        return 0;
+      },
+      active
+    );
+    graph->process_edges<VertexId,MinEdge>(
+      [&](VertexId src) {
+        // the slot only needs to know src
+        graph->emit(src, make_edge(src, src, 0));
+      },
+      [&](VertexId src, MinEdge msg, VertexAdjList<Weight> outgoing_adj) {
+        for (AdjUnit<Weight> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          VertexId dst = ptr->neighbour;
+          if (component[dst]!=component[src]) {
+            lighter->add(dst, make_edge(src, dst, ptr->edge_data));
+          }
+        }
+        return 0;
+      },
+      [&](VertexId dst, VertexAdjList<Weight> incoming_adj) {
+        MinEdge msg = LighterEdge::identity();
+        for (AdjUnit<Weight> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          VertexId src = ptr->neighbour;
+          if (component[src]!=component[dst]) {
+            LighterEdge::combine(msg, make_edge(src, dst, ptr->edge_data));
+          }
+        }
+        if (msg.low!=NO_VERTEX) {
+          graph->emit(dst, msg);
+        }
+      },
+      [&](VertexId dst, MinEdge msg) {
+        lighter->add(dst, msg);
+        return 0;
+      },
+      active, active
+    );
+    lighter->flush(lightest);
+
+    // min-combine into the component roots: owned vertices first, then across ranks
+    #pragma omp parallel for
+    for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+      best[v_i] = LighterEdge::identity();
+    }
+    for (VertexId v_i=graph->partition_offset[graph->partition_id];v_i<graph->partition_offset[graph->partition_id+1];v_i++) {
+      if (active->get_bit(v_i)) {
+        LighterEdge::combine(best[component[v_i]], lightest[v_i]);
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, best, graph->vertices, get_mpi_data_type<MinEdge>(), get_mpi_op<MinEdge, LighterEdge>(), MPI_COMM_WORLD);
+
+    // every component with an outgoing edge hooks onto the component at its other end; of two components that
+    // picked the same edge, the lower one stays a root, and every other hook adds its edge to the forest
+    VertexId hooks = 0;
+    #pragma omp parallel for reduction(+:hooks)
+    for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+      parent[v_i] = v_i;
+      if (component[v_i]==v_i && best[v_i].low!=NO_VERTEX) {
+        VertexId other = component[best[v_i].low]==v_i ? best[v_i].high : best[v_i].low;
+        parent[v_i] = component[other];
+        hooks += 1;
+      }
+    }
+    if (hooks==0) break;
+    rounds += 1;
+    for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+      if (parent[v_i]==v_i) continue;
+      if (parent[parent[v_i]]==v_i && v_i < parent[v_i]) continue;
+      forest.push_back(best[v_i]);
+      forest_weight += best[v_i].weight;
+    }
+    #pragma omp parallel for
+    for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+      if (parent[v_i]!=v_i && parent[parent[v_i]]==v_i && v_i < parent[v_i]) {
+        parent[v_i] = v_i;
+      }
+    }
+
+    // pointer jumping until every component points at the root of its tree, then contraction by relabelling;
+    // vertices whose component found no outgoing edge are done
+    for (bool jumped=true;jumped;) {
+      jumped = false;
+      #pragma omp parallel for reduction(||:jumped)
+      for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+        VertexId grandparent = parent[parent[v_i]];
+        if (parent[v_i]!=grandparent) {
+          parent[v_i] = grandparent;
+          jumped = true;
+        }
+      }
+    }
+    active->clear();
+    #pragma omp parallel for
+    for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+      bool hooked = best[component[v_i]].low!=NO_VERTEX;
+      component[v_i] = parent[component[v_i]];
+      if (hooked && v_i >= graph->partition_offset[graph->partition_id] && v_i < graph->partition_offset[graph->partition_id+1]) {
+        active->set_bit(v_i);
+      }
+    }
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+  }
+
+  // the forest is known to every rank; the first one writes it in the input format
+  if (output_path!="" && graph->partition_id==0) {
+    FILE * fout = fopen(output_path.c_str(), "wb");
+    assert(fout!=NULL);
+    for (MinEdge & edge : forest) {
+      EdgeUnit<Weight> unit;
+      unit.src = edge.low;
+      unit.dst = edge.high;
+      unit.edge_data = edge.weight;
+      assert(fwrite(&unit, sizeof(unit), 1, fout)==1);
+    }
+    assert(fclose(fout)==0);
+  }
+
+  VertexId trees = graph->count_vertices(
+    [&](VertexId vtx) {
+      return component[vtx]==vtx;
+    }
+  );
+  if (graph->partition_id==0) {
+    printf("rounds = %d\n", rounds);
+    printf("forest edges = %lu\n", forest.size());
+    printf("trees = %lu\n", trees);
+    printf("total weight = %lf\n", forest_weight);
+  }
+
+  graph->dealloc_vertex_array(component);
+  graph->dealloc_vertex_array(parent);
+  graph->dealloc_vertex_array(lightest);
+  graph->dealloc_vertex_array(best);
+  delete active;
+  delete lighter;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<4) {
+    printf("msf [threads] [file] [vertices] [output] [symmetric]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Weight> * graph;
+  graph = new Graph<Weight>(threads);
+  bool symmetric = argc >= 6 && std::atoi(argv[5])!=0;
+  if (symmetric) {
+    graph->load_symmetric(argv[2], std::strtoul(argv[3], &end, 10));
+  } else {
+    graph->load_undirected_from_directed(argv[2], std::strtoul(argv[3], &end, 10));
+  }
+
+  std::string output_path = argc >= 5 ? argv[4] : "";
+
+  compute(graph, output_path);
+  for (int run=0;run<5;run++) {
+    compute(graph, output_path);
+  }
+
+  delete graph;
+  return 0;
+}
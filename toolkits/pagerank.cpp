@@ -23,7 +23,7 @@ Copyright (c) 2014-2015 Xiaowei Zhu, Tsinghua University
 
 const double d = (double)0.85;
 
-void compute(Graph<Empty> * graph, int iterations) {
+void compute(Graph<Empty> * graph, int iterations, std::string output_path) {
   double exec_time = 0;
   exec_time -= get_time();
 
@@ -114,13 +114,13 @@ void compute(Graph<Empty> * graph, int iterations) {
     printf("pr_sum=%lf\n", pr_sum);
   }
 
-  graph->gather_vertex_array(curr, 0);
+  if (output_path!="") {
+    graph->dump_vertex_array(curr, output_path);
+  }
+
+  std::pair<VertexId,double> max_pr = graph->arg_max(curr);
   if (graph->partition_id==0) {
-    VertexId max_v_i = 0;
-    for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
-      if (curr[v_i] > curr[max_v_i]) max_v_i = v_i;
-    }
-    printf("pr[%lu]=%lf\n", max_v_i, curr[max_v_i]);
+    printf("pr[%lu]=%lf\n", max_pr.first, max_pr.second);
   }
 
   graph->dealloc_vertex_array(curr);
@@ -134,7 +134,7 @@ int main(int argc, char ** argv) {
   int threads;
 
   if (argc<5) {
-    printf("pagerank [threads] [file] [vertices] [iterations]\n");
+    printf("pagerank [threads] [file] [vertices] [iterations] [output] [adjacency_dir]\n");
     exit(-1);
   }
 
@@ -143,13 +143,17 @@ int main(int argc, char ** argv) {
 
   Graph<Empty> * graph;
   graph = new Graph<Empty>(threads);
+  if (argc >= 7) {
+    graph->store_adjacency_in(argv[6]);
+  }
   //graph->load_directed(argv[1], std::atol(argv[2]));
   graph->load_directed(argv[2], std::strtoul(argv[3], &end, 10));
   int iterations = std::atoi(argv[4]);
+  std::string output_path = argc >= 6 ? argv[5] : "";
 
-  compute(graph, iterations);
+  compute(graph, iterations, output_path);
   for (int run=0;run<5;run++) {
-    compute(graph, iterations);
+    compute(graph, iterations, output_path);
   }
 
   delete graph;
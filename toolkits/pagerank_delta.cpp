@@ -0,0 +1,158 @@
+/*
+Copyright (c) 2014-2015 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/graph.hpp"
+
+#include <math.h>
+
+const double d = (double)0.85;
+
+void compute(Graph<Empty> * graph, double tolerance, std::string output_path) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  double * rank = graph->alloc_vertex_array<double>();
+  double * residual = graph->alloc_vertex_array<double>();
+  double * push = graph->alloc_vertex_array<double>();
+  VertexSubset * active_all = graph->alloc_vertex_subset();
+  active_all->fill();
+  VertexSubset * active = graph->alloc_vertex_subset();
+  Accumulator<double, SumReduction<double>> * pushed = graph->alloc_accumulator<double>();
+
+  graph->fill_vertex_array(rank, (double)0);
+  graph->fill_vertex_array(residual, 1 - d);
+
+  int i_i;
+  for (i_i=0;;i_i++) {
+    // vertices holding at least tolerance of residual absorb it and push d/out_degree of it to their neighbours
+    active->clear();
+    double delta = graph->process_vertices<double>(
+      [&](VertexId vtx) {
+        double r = residual[vtx];
+        if (fabs(r) >= tolerance) {
+          rank[vtx] += r;
+          push[vtx] = 0;
+          if (graph->out_degree[vtx]>0) {
+            push[vtx] = d * r / graph->out_degree[vtx];
+          }
+          residual[vtx] = 0;
+          active->set_bit(vtx);
+        }
+        return fabs(r);
+      },
+      active_all
+    );
+    delta /= graph->vertices;
+    if (graph->partition_id==0) {
+      printf("delta(%d)=%lf\n", i_i, delta);
+    }
+    if (delta < tolerance) break;
+    graph->process_edges<int,double>(
+      [&](VertexId src){
+        graph->emit(src, push[src]);
+      },
+      [&](VertexId src, double msg, VertexAdjList<Empty> outgoing_adj){
+        for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          VertexId dst = ptr->neighbour;
+          pushed->add(dst, msg);
+        }
+        return 0;
+      },
+      [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+        double sum = 0;
+        for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          VertexId src = ptr->neighbour;
+          if (active->get_bit(src)) {
+            sum += push[src];
+          }
+        }
+        if (sum != 0) {
+          graph->emit(dst, sum);
+        }
+      },
+      [&](VertexId dst, double msg) {
+        write_add(&residual[dst], msg);
+        return 0;
+      },
+      active
+    );
+    pushed->flush(residual);
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("iterations=%d\n", i_i);
+    printf("exec_time=%lf(s)\n", exec_time);
+  }
+
+  double pr_sum = graph->process_vertices<double>(
+    [&](VertexId vtx) {
+      return rank[vtx];
+    },
+    active_all
+  );
+  if (graph->partition_id==0) {
+    printf("pr_sum=%lf\n", pr_sum);
+  }
+
+  if (output_path!="") {
+    graph->dump_vertex_array(rank, output_path);
+  }
+
+  std::pair<VertexId,double> max_pr = graph->arg_max(rank);
+  if (graph->partition_id==0) {
+    printf("pr[%lu]=%lf\n", max_pr.first, max_pr.second);
+  }
+
+  graph->dealloc_vertex_array(rank);
+  graph->dealloc_vertex_array(residual);
+  graph->dealloc_vertex_array(push);
+  delete active_all;
+  delete active;
+  delete pushed;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<5) {
+    printf("pagerank_delta [threads] [file] [vertices] [tolerance] [output]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+  graph->load_directed(argv[2], std::strtoul(argv[3], &end, 10));
+  double tolerance = std::atof(argv[4]);
+  assert(tolerance > 0);
+  std::string output_path = argc >= 6 ? argv[5] : "";
+
+  compute(graph, tolerance, output_path);
+  for (int run=0;run<5;run++) {
+    compute(graph, tolerance, output_path);
+  }
+
+  delete graph;
+  return 0;
+}
@@ -0,0 +1,220 @@
+/*
+Copyright (c) 2014-2015 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/graph.hpp"
+
+#include <math.h>
+
+const double d = (double)0.85;
+
+// push the pending rank of active_in along its out-edges; activates vertices whose residual exceeds epsilon
+void propagate(Graph<Empty> * graph, double * push, double * residual, VertexSubset * active_in, VertexSubset * active_out, double epsilon) {
+  graph->process_edges<int,double>(
+    [&](VertexId src){
+      graph->emit(src, push[src]);
+    },
+    [&](VertexId src, double msg, VertexAdjList<Empty> outgoing_adj){
+      for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+        VertexId dst = ptr->neighbour;
+        write_add(&residual[dst], msg);
+        if (fabs(residual[dst]) > epsilon) {
+          active_out->set_bit(dst);
+        }
+      }
+      return 0;
+    },
+    [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+      double sum = 0;
+      for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+        VertexId src = ptr->neighbour;
+        if (active_in->get_bit(src)) {
+          sum += push[src];
+        }
+      }
+      if (sum != 0) {
+        graph->emit(dst, sum);
+      }
+    },
+    [&](VertexId dst, double msg) {
+      write_add(&residual[dst], msg);
+      if (fabs(residual[dst]) > epsilon) {
+        active_out->set_bit(dst);
+      }
+      return 0;
+    },
+    active_in
+  );
+}
+
+void compute(Graph<Empty> * graph, std::string prev_path, std::string batch_path, double epsilon, std::string output_path) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  double * rank = graph->alloc_vertex_array<double>();
+  double * residual = graph->alloc_vertex_array<double>();
+  double * push = graph->alloc_vertex_array<double>();
+  VertexId * inserted = graph->alloc_vertex_array<VertexId>();
+  VertexSubset * active_in = graph->alloc_vertex_subset();
+  VertexSubset * active_out = graph->alloc_vertex_subset();
+
+  graph->restore_vertex_array(rank, prev_path);
+  graph->fill_vertex_array(residual, (double)0);
+  graph->fill_vertex_array(inserted, (VertexId)0);
+
+  VertexId begin_v_i = graph->partition_offset[graph->partition_id];
+  VertexId end_v_i = graph->partition_offset[graph->partition_id+1];
+  std::vector<EdgeUnit<Empty> > batch = read_edge_batch<Empty>(batch_path);
+  active_in->clear();
+  for (size_t e_i=0;e_i<batch.size();e_i++) {
+    VertexId src = batch[e_i].src;
+    if (src >= begin_v_i && src < end_v_i) {
+      inserted[src] += 1;
+      active_in->set_bit(src);
+    }
+  }
+
+  // every source of an inserted edge now splits its rank 1/new instead of 1/old ways
+  graph->process_vertices<VertexId>(
+    [&](VertexId vtx) {
+      VertexId old_degree = graph->out_degree[vtx] - inserted[vtx];
+      if (old_degree > 0) {
+        push[vtx] = d * rank[vtx] * (1.0 / graph->out_degree[vtx] - 1.0 / old_degree);
+      } else {
+        push[vtx] = d * rank[vtx] / graph->out_degree[vtx];
+      }
+      return 1;
+    },
+    active_in
+  );
+  active_out->clear();
+  propagate(graph, push, residual, active_in, active_out, epsilon);
+
+  // the inserted edges themselves still miss the 1/old share pushed above; owners of the sources provide it
+  double * correction = new double [batch.size()];
+  for (size_t e_i=0;e_i<batch.size();e_i++) {
+    VertexId src = batch[e_i].src;
+    correction[e_i] = 0;
+    if (src >= begin_v_i && src < end_v_i && graph->out_degree[src] > inserted[src]) {
+      correction[e_i] = d * rank[src] / (graph->out_degree[src] - inserted[src]);
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, correction, batch.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  for (size_t e_i=0;e_i<batch.size();e_i++) {
+    VertexId dst = batch[e_i].dst;
+    if (dst >= begin_v_i && dst < end_v_i) {
+      residual[dst] += correction[e_i];
+      if (fabs(residual[dst]) > epsilon) {
+        active_out->set_bit(dst);
+      }
+    }
+  }
+  delete [] correction;
+
+  VertexId active_vertices = graph->process_vertices<VertexId>(
+    [&](VertexId vtx) {
+      return 1;
+    },
+    active_out
+  );
+  std::swap(active_in, active_out);
+
+  for (int i_i=0;active_vertices>0;i_i++) {
+    if (graph->partition_id==0) {
+      printf("active(%d)>=%lu\n", i_i, active_vertices);
+    }
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        rank[vtx] += residual[vtx];
+        push[vtx] = 0;
+        if (graph->out_degree[vtx]>0) {
+          push[vtx] = d * residual[vtx] / graph->out_degree[vtx];
+        }
+        residual[vtx] = 0;
+        return 1;
+      },
+      active_in
+    );
+    active_out->clear();
+    propagate(graph, push, residual, active_in, active_out, epsilon);
+    active_vertices = graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        return 1;
+      },
+      active_out
+    );
+    std::swap(active_in, active_out);
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+  }
+
+  active_in->fill();
+  double pr_sum = graph->process_vertices<double>(
+    [&](VertexId vtx) {
+      return rank[vtx];
+    },
+    active_in
+  );
+  if (graph->partition_id==0) {
+    printf("pr_sum=%lf\n", pr_sum);
+  }
+
+  if (output_path!="") {
+    graph->dump_vertex_array(rank, output_path);
+  }
+
+  std::pair<VertexId,double> max_pr = graph->arg_max(rank);
+  if (graph->partition_id==0) {
+    printf("pr[%lu]=%lf\n", max_pr.first, max_pr.second);
+  }
+
+  graph->dealloc_vertex_array(rank);
+  graph->dealloc_vertex_array(residual);
+  graph->dealloc_vertex_array(push);
+  graph->dealloc_vertex_array(inserted);
+  delete active_in;
+  delete active_out;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<7) {
+    printf("pagerank_incremental [threads] [file] [vertices] [prev_ranks] [inserted_edges] [epsilon] [output]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+  graph->load_directed(argv[2], std::strtoul(argv[3], &end, 10));
+  double epsilon = std::atof(argv[6]);
+  std::string output_path = argc >= 8 ? argv[7] : "";
+
+  compute(graph, argv[4], argv[5], epsilon, output_path);
+
+  delete graph;
+  return 0;
+}
@@ -0,0 +1,57 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/memory.hpp"
+
+// dry run: predicts the per-rank footprint of a load without touching the graph or starting MPI
+int main(int argc, char ** argv) {
+  if (argc<6) {
+    printf("plan_memory <vertices> <edges> <ranks> <sockets> <edge_data_size> [undirected] [message_size] [subsets]\n");
+    exit(-1);
+  }
+
+  VertexId vertices = std::strtoul(argv[1], NULL, 10);
+  EdgeId edges = std::strtoul(argv[2], NULL, 10);
+  int partitions = std::atoi(argv[3]);
+  int sockets = std::atoi(argv[4]);
+  size_t edge_data_size = std::strtoul(argv[5], NULL, 10);
+  // 1: load_undirected_from_directed, 2: load_symmetric (the file lists both directions, so half as many edges are undirected ones)
+  int undirected = argc>=7 ? std::atoi(argv[6]) : 0;
+  bool symmetric = undirected!=0;
+  if (undirected==2) {
+    edges /= 2;
+  }
+  size_t message_size = sizeof(double);
+  if (argc>=8) {
+    message_size = std::strtoul(argv[7], NULL, 10);
+  }
+  // vertex subsets the toolkit allocates (e.g. active_in and active_out)
+  int subsets = argc>=9 ? std::atoi(argv[8]) : 2;
+  assert(vertices > 0 && partitions > 0 && sockets > 0 && subsets >= 0);
+
+  MemoryPlan plan = plan_memory(vertices, edges, partitions, sockets, edge_data_size, symmetric, message_size, subsets);
+  for (auto & it : plan.loaded) {
+    printf("%s: %lu bytes\n", it.first.c_str(), it.second);
+  }
+  size_t peak_bytes = std::max(plan.loaded_bytes, plan.loading_peak_bytes);
+  printf("per rank after loading: %lu bytes (%.2lf GB, %.2lf GB per socket)\n", plan.loaded_bytes, plan.loaded_bytes / 1e9, plan.loaded_bytes / 1e9 / sockets);
+  printf("per rank while loading: %lu bytes (%.2lf GB)\n", plan.loading_peak_bytes, plan.loading_peak_bytes / 1e9);
+  printf("peak per rank: %lu bytes (%.2lf GB)\n", peak_bytes, peak_bytes / 1e9);
+  return 0;
+}
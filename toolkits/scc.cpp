@@ -0,0 +1,389 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/graph.hpp"
+
+// trimming rounds before the remaining vertices are left to forward-backward and coloring
+#define TRIM_ROUNDS 8
+// forward-backward keeps picking pivots while their SCCs hold at least 1/FWBW_RATIO of the remaining vertices
+#define FWBW_RATIO 100
+
+// number of live in-neighbours of every live vertex (out-neighbours on a transposed graph)
+void count_live_neighbours(Graph<Empty> * graph, VertexSubset * live, VertexId * count) {
+  Accumulator<VertexId, SumReduction<VertexId>> * counted = graph->alloc_accumulator<VertexId>();
+  graph->fill_vertex_array(count, (VertexId)0);
+  graph->process_edges<VertexId,VertexId>(
+    [&](VertexId src){
+      graph->emit(src, (VertexId)1);
+    },
+    [&](VertexId src, VertexId msg, VertexAdjList<Empty> outgoing_adj){
+      for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+        VertexId dst = ptr->neighbour;
+        if (live->get_bit(dst)) {
+          counted->add(dst, 1);
+        }
+      }
+      return 0;
+    },
+    [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+      if (!live->get_bit(dst)) return;
+      VertexId msg = 0;
+      for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+        VertexId src = ptr->neighbour;
+        if (live->get_bit(src)) {
+          msg += 1;
+        }
+      }
+      if (msg > 0) {
+        graph->emit(dst, msg);
+      }
+    },
+    [&](VertexId dst, VertexId msg) {
+      write_add(&count[dst], msg);
+      return 0;
+    },
+    live, live
+  );
+  counted->flush(count);
+  delete counted;
+}
+
+// grows visited from frontier along edges (reversed ones on a transposed graph) whose endpoints share a color;
+// visited must already contain the frontier and every vertex that is out of bounds, and frontier is consumed
+VertexId traverse(Graph<Empty> * graph, VertexId * color, VertexSubset * visited, VertexSubset * frontier) {
+  VertexSubset * active_in = frontier;
+  VertexSubset * active_out = graph->alloc_vertex_subset();
+  VertexId reached_vertices = 0;
+  VertexId active_vertices = graph->process_vertices<VertexId>(
+    [&](VertexId vtx) {
+      return 1;
+    },
+    active_in
+  );
+  while (active_vertices > 0) {
+    reached_vertices += active_vertices;
+    active_out->clear();
+    graph->process_edges<VertexId,VertexId>(
+      [&](VertexId src){
+        graph->emit(src, color[src]);
+      },
+      [&](VertexId src, VertexId msg, VertexAdjList<Empty> outgoing_adj){
+        for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          VertexId dst = ptr->neighbour;
+          if (!visited->get_bit(dst) && color[dst]==msg) {
+            active_out->set_bit(dst);
+          }
+        }
+        return 0;
+      },
+      [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+        if (visited->get_bit(dst)) return;
+        // colors only grow along the original edges, so a matching color is the smallest one offered
+        VertexId msg = graph->vertices;
+        for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          VertexId src = ptr->neighbour;
+          if (active_in->get_bit(src) && color[src] < msg) {
+            msg = color[src];
+          }
+        }
+        if (msg < graph->vertices) {
+          graph->emit(dst, msg);
+        }
+      },
+      [&](VertexId dst, VertexId msg) {
+        if (!visited->get_bit(dst) && color[dst]==msg) {
+          active_out->set_bit(dst);
+        }
+        return 0;
+      },
+      active_in, visited
+    );
+    active_vertices = graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        visited->set_bit(vtx);
+        return 1;
+      },
+      active_out
+    );
+    std::swap(active_in, active_out);
+  }
+  if (active_out==frontier) {
+    delete active_in;
+  } else {
+    delete active_out;
+  }
+  return reached_vertices;
+}
+
+void compute(Graph<Empty> * graph, std::string output_path) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  VertexId * scc = graph->alloc_vertex_array<VertexId>();
+  VertexId * color = graph->alloc_vertex_array<VertexId>();
+  VertexId * in_count = graph->alloc_vertex_array<VertexId>();
+  VertexId * out_count = graph->alloc_vertex_array<VertexId>();
+  VertexSubset * live = graph->alloc_vertex_subset();
+  VertexSubset * forward = graph->alloc_vertex_subset();
+  VertexSubset * backward = graph->alloc_vertex_subset();
+  VertexSubset * active_in = graph->alloc_vertex_subset();
+  VertexSubset * active_out = graph->alloc_vertex_subset();
+  Accumulator<VertexId, MaxReduction<VertexId>> * raised = graph->alloc_accumulator<VertexId, MaxReduction<VertexId>>();
+
+  graph->fill_vertex_array(scc, graph->vertices);
+  live->fill();
+  VertexId live_vertices = graph->vertices;
+
+  // trimming: a vertex without live in- or out-neighbours is an SCC of its own
+  VertexId trimmed_vertices = 0;
+  for (int r_i=0;r_i<TRIM_ROUNDS;r_i++) {
+    count_live_neighbours(graph, live, in_count);
+    graph->transpose();
+    count_live_neighbours(graph, live, out_count);
+    graph->transpose();
+    VertexId trimmed = graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        if (in_count[vtx]==0 || out_count[vtx]==0) {
+          scc[vtx] = vtx;
+          live->clear_bit(vtx);
+          return 1;
+        }
+        return 0;
+      },
+      live
+    );
+    trimmed_vertices += trimmed;
+    live_vertices -= trimmed;
+    if (trimmed==0) break;
+  }
+
+  // forward-backward: the SCC of a pivot is what it reaches and what reaches it, within the live vertices
+  VertexId pivot_sccs = 0;
+  VertexId pivot_vertices = 0;
+  while (live_vertices > 0) {
+    // the likeliest member of a large SCC has many live in- and out-neighbours
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        color[vtx] = in_count[vtx] * out_count[vtx];
+        return 0;
+      },
+      live
+    );
+    VertexId p_v_i = graph->arg_max(color, [&](VertexId vtx) {
+      return live->get_bit(vtx) != 0;
+    }).first;
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        color[vtx] = p_v_i;
+        return 0;
+      },
+      live
+    );
+    VertexSubset * reached[2] = {forward, backward};
+    for (int d_i=0;d_i<2;d_i++) {
+      reached[d_i]->fill();
+      graph->process_vertices<VertexId>(
+        [&](VertexId vtx) {
+          reached[d_i]->clear_bit(vtx);
+          return 0;
+        },
+        live
+      );
+      reached[d_i]->set_bit(p_v_i);
+      active_in->clear();
+      active_in->set_bit(p_v_i);
+      if (d_i==1) graph->transpose();
+      traverse(graph, color, reached[d_i], active_in);
+      if (d_i==1) graph->transpose();
+    }
+    VertexId found = graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        if (forward->get_bit(vtx) && backward->get_bit(vtx)) {
+          scc[vtx] = p_v_i;
+          live->clear_bit(vtx);
+          return 1;
+        }
+        return 0;
+      },
+      live
+    );
+    pivot_sccs += 1;
+    pivot_vertices += found;
+    live_vertices -= found;
+    if (found * FWBW_RATIO < live_vertices + found) break;
+  }
+
+  // coloring: every live vertex takes the largest id that reaches it; a vertex keeping its own id is the root of
+  // an SCC made of the vertices of its color that reach it
+  int color_rounds = 0;
+  while (live_vertices > 0) {
+    color_rounds += 1;
+    active_in->clear();
+    VertexId active_vertices = graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        color[vtx] = vtx;
+        active_in->set_bit(vtx);
+        return 1;
+      },
+      live
+    );
+    while (active_vertices > 0) {
+      active_out->clear();
+      active_vertices = graph->process_edges<VertexId,VertexId>(
+        [&](VertexId src){
+          graph->emit(src, color[src]);
+        },
+        [&](VertexId src, VertexId msg, VertexAdjList<Empty> outgoing_adj){
+          for (AdjUnit<Empty> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+            VertexId dst = ptr->neighbour;
+            if (live->get_bit(dst) && msg > color[dst]) {
+              raised->add(dst, msg);
+            }
+          }
+          return 0;
+        },
+        [&](VertexId dst, VertexAdjList<Empty> incoming_adj) {
+          if (!live->get_bit(dst)) return;
+          VertexId msg = 0;
+          bool found = false;
+          for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+            VertexId src = ptr->neighbour;
+            if (active_in->get_bit(src) && (!found || color[src] > msg)) {
+              msg = color[src];
+              found = true;
+            }
+          }
+          if (found && msg > dst) {
+            graph->emit(dst, msg);
+          }
+        },
+        [&](VertexId dst, VertexId msg) {
+          if (live->get_bit(dst) && msg > color[dst]) {
+            write_max(&color[dst], msg);
+            active_out->set_bit(dst);
+            return 1;
+          }
+          return 0;
+        },
+        active_in, live
+      );
+      active_vertices += raised->flush(color, active_out);
+      std::swap(active_in, active_out);
+    }
+    forward->fill();
+    active_in->clear();
+    graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        if (color[vtx]==vtx) {
+          active_in->set_bit(vtx);
+        } else {
+          forward->clear_bit(vtx);
+        }
+        return 0;
+      },
+      live
+    );
+    graph->transpose();
+    traverse(graph, color, forward, active_in);
+    graph->transpose();
+    VertexId found = graph->process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        if (forward->get_bit(vtx)) {
+          scc[vtx] = color[vtx];
+          live->clear_bit(vtx);
+          return 1;
+        }
+        return 0;
+      },
+      live
+    );
+    live_vertices -= found;
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+    printf("trimmed = %lu, forward-backward = %lu in %lu sccs, coloring rounds = %d\n", trimmed_vertices, pivot_vertices, pivot_sccs, color_rounds);
+  }
+
+  if (output_path!="") {
+    graph->dump_vertex_array(scc, output_path);
+  }
+
+  // every SCC is labelled with one of its vertices
+  VertexId sccs = graph->count_vertices(
+    [&](VertexId vtx) {
+      return scc[vtx] == vtx;
+    }
+  );
+  VertexId * scc_size = in_count;
+  #pragma omp parallel for
+  for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+    scc_size[v_i] = 0;
+  }
+  #pragma omp parallel for
+  for (VertexId v_i=graph->partition_offset[graph->partition_id];v_i<graph->partition_offset[graph->partition_id+1];v_i++) {
+    write_add(&scc_size[scc[v_i]], (VertexId)1);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, scc_size, graph->vertices, get_mpi_data_type<VertexId>(), MPI_SUM, MPI_COMM_WORLD);
+  std::pair<VertexId,VertexId> largest = graph->arg_max(scc_size);
+  if (graph->partition_id==0) {
+    printf("sccs = %lu\n", sccs);
+    printf("largest scc = %lu (scc[%lu])\n", largest.second, largest.first);
+  }
+
+  graph->dealloc_vertex_array(scc);
+  graph->dealloc_vertex_array(color);
+  graph->dealloc_vertex_array(in_count);
+  graph->dealloc_vertex_array(out_count);
+  delete live;
+  delete forward;
+  delete backward;
+  delete active_in;
+  delete active_out;
+  delete raised;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<4) {
+    printf("scc [threads] [file] [vertices] [output]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+  graph->load_directed(argv[2], std::strtoul(argv[3], &end, 10));
+
+  std::string output_path = argc >= 5 ? argv[4] : "";
+
+  compute(graph, output_path);
+  for (int run=0;run<5;run++) {
+    compute(graph, output_path);
+  }
+
+  delete graph;
+  return 0;
+}
@@ -0,0 +1,639 @@
+/*
+Copyright (c) 2014-2015 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <math.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <map>
+#include <sstream>
+
+#include "core/graph.hpp"
+
+// a job is a single line, e.g. "bfs 0", "sssp 12", "bc 3", "pagerank 20" or "quit"
+#define MAX_JOB_LENGTH 256
+
+typedef float Weight;
+
+// recycles vertex arrays and subsets across jobs instead of mapping and unmapping them for every query
+template <typename EdgeData>
+class VertexArrayPool {
+  Graph<EdgeData> * graph;
+  std::map<size_t, std::vector<void *> > free_arrays;
+  std::vector<VertexSubset *> free_subsets;
+public:
+  VertexArrayPool(Graph<EdgeData> * graph) : graph(graph) { }
+  ~VertexArrayPool() {
+    for (auto & it : free_arrays) {
+      for (void * array : it.second) {
+        graph->dealloc_vertex_array(array);
+      }
+    }
+    for (VertexSubset * subset : free_subsets) {
+      delete subset;
+    }
+  }
+  template<typename T>
+  T * alloc_vertex_array() {
+    std::vector<void *> & arrays = free_arrays[sizeof(T)];
+    if (arrays.empty()) {
+      return graph->template alloc_vertex_array<T>();
+    }
+    T * array = (T *)arrays.back();
+    arrays.pop_back();
+    return array;
+  }
+  template<typename T>
+  void dealloc_vertex_array(T * array) {
+    free_arrays[sizeof(T)].push_back(array);
+  }
+  VertexSubset * alloc_vertex_subset() {
+    if (free_subsets.empty()) {
+      return graph->alloc_vertex_subset();
+    }
+    VertexSubset * subset = free_subsets.back();
+    free_subsets.pop_back();
+    return subset;
+  }
+  void dealloc_vertex_subset(VertexSubset * subset) {
+    free_subsets.push_back(subset);
+  }
+};
+
+template <typename EdgeData>
+std::string run_pagerank(Graph<EdgeData> * graph, VertexArrayPool<EdgeData> & pool, int iterations) {
+  const double d = (double)0.85;
+  double * curr = pool.template alloc_vertex_array<double>();
+  double * next = pool.template alloc_vertex_array<double>();
+  VertexSubset * active = pool.alloc_vertex_subset();
+  active->fill();
+
+  graph->template process_vertices<double>(
+    [&](VertexId vtx){
+      curr[vtx] = (double)1;
+      if (graph->out_degree[vtx]>0) {
+        curr[vtx] /= graph->out_degree[vtx];
+      }
+      return (double)1;
+    },
+    active
+  );
+  for (int i_i=0;i_i<iterations;i_i++) {
+    graph->fill_vertex_array(next, (double)0);
+    graph->template process_edges<int,double>(
+      [&](VertexId src){
+        graph->emit(src, curr[src]);
+      },
+      [&](VertexId src, double msg, VertexAdjList<EdgeData> outgoing_adj){
+        for (AdjUnit<EdgeData> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          VertexId dst = ptr->neighbour;
+          write_add(&next[dst], msg);
+        }
+        return 0;
+      },
+      [&](VertexId dst, VertexAdjList<EdgeData> incoming_adj) {
+        double sum = 0;
+        for (AdjUnit<EdgeData> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          VertexId src = ptr->neighbour;
+          sum += curr[src];
+        }
+        graph->emit(dst, sum);
+      },
+      [&](VertexId dst, double msg) {
+        write_add(&next[dst], msg);
+        return 0;
+      },
+      active
+    );
+    bool last = i_i==iterations-1;
+    graph->template process_vertices<double>(
+      [&](VertexId vtx) {
+        next[vtx] = 1 - d + d * next[vtx];
+        if (!last && graph->out_degree[vtx]>0) {
+          next[vtx] /= graph->out_degree[vtx];
+        }
+        return 0;
+      },
+      active
+    );
+    std::swap(curr, next);
+  }
+  double pr_sum = graph->template process_vertices<double>(
+    [&](VertexId vtx) {
+      return curr[vtx];
+    },
+    active
+  );
+  std::pair<VertexId,double> max_pr = graph->arg_max(curr);
+
+  pool.dealloc_vertex_array(curr);
+  pool.dealloc_vertex_array(next);
+  pool.dealloc_vertex_subset(active);
+
+  char result[MAX_JOB_LENGTH];
+  snprintf(result, MAX_JOB_LENGTH, "pr_sum=%lf pr[%lu]=%lf", pr_sum, max_pr.first, max_pr.second);
+  return result;
+}
+
+template <typename EdgeData>
+std::string run_bfs(Graph<EdgeData> * graph, VertexArrayPool<EdgeData> & pool, VertexId root) {
+  VertexId * parent = pool.template alloc_vertex_array<VertexId>();
+  VertexSubset * visited = pool.alloc_vertex_subset();
+  VertexSubset * active_in = pool.alloc_vertex_subset();
+  VertexSubset * active_out = pool.alloc_vertex_subset();
+
+  visited->clear();
+  visited->set_bit(root);
+  active_in->clear();
+  active_in->set_bit(root);
+  graph->fill_vertex_array(parent, graph->vertices);
+  parent[root] = root;
+
+  VertexId active_vertices = 1;
+  VertexId found_vertices = 1;
+  int i_i;
+  for (i_i=0;active_vertices>0;i_i++) {
+    active_out->clear();
+    graph->template process_edges<VertexId,VertexId>(
+      [&](VertexId src){
+        graph->emit(src, src);
+      },
+      [&](VertexId src, VertexId msg, VertexAdjList<EdgeData> outgoing_adj){
+        VertexId activated = 0;
+        for (AdjUnit<EdgeData> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          VertexId dst = ptr->neighbour;
+          if (parent[dst]==graph->vertices && cas(&parent[dst], graph->vertices, src)) {
+            active_out->set_bit(dst);
+            activated += 1;
+          }
+        }
+        return activated;
+      },
+      [&](VertexId dst, VertexAdjList<EdgeData> incoming_adj) {
+        if (visited->get_bit(dst)) return;
+        for (AdjUnit<EdgeData> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          VertexId src = ptr->neighbour;
+          if (active_in->get_bit(src)) {
+            graph->emit(dst, src);
+            break;
+          }
+        }
+      },
+      [&](VertexId dst, VertexId msg) {
+        if (cas(&parent[dst], graph->vertices, msg)) {
+          active_out->set_bit(dst);
+          return 1;
+        }
+        return 0;
+      },
+      active_in, visited
+    );
+    active_vertices = graph->template process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        visited->set_bit(vtx);
+        return 1;
+      },
+      active_out
+    );
+    found_vertices += active_vertices;
+    std::swap(active_in, active_out);
+  }
+
+  pool.dealloc_vertex_array(parent);
+  pool.dealloc_vertex_subset(visited);
+  pool.dealloc_vertex_subset(active_in);
+  pool.dealloc_vertex_subset(active_out);
+
+  char result[MAX_JOB_LENGTH];
+  snprintf(result, MAX_JOB_LENGTH, "found_vertices=%lu levels=%d", found_vertices, i_i);
+  return result;
+}
+
+std::string run_sssp(Graph<Weight> * graph, VertexArrayPool<Weight> & pool, VertexId root) {
+  Weight * distance = pool.alloc_vertex_array<Weight>();
+  VertexSubset * active_in = pool.alloc_vertex_subset();
+  VertexSubset * active_out = pool.alloc_vertex_subset();
+  active_in->clear();
+  active_in->set_bit(root);
+  graph->fill_vertex_array(distance, (Weight)1e9);
+  distance[root] = (Weight)0;
+  VertexId active_vertices = 1;
+
+  for (int i_i=0;active_vertices>0;i_i++) {
+    active_out->clear();
+    active_vertices = graph->process_edges<VertexId,Weight>(
+      [&](VertexId src){
+        graph->emit(src, distance[src]);
+      },
+      [&](VertexId src, Weight msg, VertexAdjList<Weight> outgoing_adj){
+        VertexId activated = 0;
+        for (AdjUnit<Weight> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          VertexId dst = ptr->neighbour;
+          Weight relax_dist = msg + ptr->edge_data;
+          if (relax_dist < distance[dst]) {
+            if (write_min(&distance[dst], relax_dist)) {
+              active_out->set_bit(dst);
+              activated += 1;
+            }
+          }
+        }
+        return activated;
+      },
+      [&](VertexId dst, VertexAdjList<Weight> incoming_adj) {
+        Weight msg = 1e9;
+        for (AdjUnit<Weight> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          VertexId src = ptr->neighbour;
+          Weight relax_dist = distance[src] + ptr->edge_data;
+          if (relax_dist < msg) {
+            msg = relax_dist;
+          }
+        }
+        if (msg < 1e9) graph->emit(dst, msg);
+      },
+      [&](VertexId dst, Weight msg) {
+        if (msg < distance[dst]) {
+          write_min(&distance[dst], msg);
+          active_out->set_bit(dst);
+          return 1;
+        }
+        return 0;
+      },
+      active_in
+    );
+    std::swap(active_in, active_out);
+  }
+
+  std::pair<VertexId,Weight> max_distance = graph->arg_max(distance, [&](VertexId vtx) { return distance[vtx] < 1e9; });
+
+  pool.dealloc_vertex_array(distance);
+  pool.dealloc_vertex_subset(active_in);
+  pool.dealloc_vertex_subset(active_out);
+
+  char result[MAX_JOB_LENGTH];
+  snprintf(result, MAX_JOB_LENGTH, "distance[%lu]=%f", max_distance.first, max_distance.second);
+  return result;
+}
+
+template <typename EdgeData>
+std::string run_bc(Graph<EdgeData> * graph, VertexArrayPool<EdgeData> & pool, VertexId root) {
+  double * num_paths = pool.template alloc_vertex_array<double>();
+  double * dependencies = pool.template alloc_vertex_array<double>();
+  VertexSubset * active_all = pool.alloc_vertex_subset();
+  active_all->fill();
+  VertexSubset * visited = pool.alloc_vertex_subset();
+  std::vector<VertexSubset *> levels;
+  VertexSubset * active_in = pool.alloc_vertex_subset();
+
+  VertexId active_vertices = 1;
+  visited->clear();
+  visited->set_bit(root);
+  active_in->clear();
+  active_in->set_bit(root);
+  levels.push_back(active_in);
+  graph->fill_vertex_array(num_paths, 0.0);
+  num_paths[root] = 1.0;
+  while (active_vertices>0) {
+    VertexSubset * active_out = pool.alloc_vertex_subset();
+    active_out->clear();
+    graph->template process_edges<VertexId,double>(
+      [&](VertexId src){
+        graph->emit(src, num_paths[src]);
+      },
+      [&](VertexId src, double msg, VertexAdjList<EdgeData> outgoing_adj){
+        for (AdjUnit<EdgeData> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          VertexId dst = ptr->neighbour;
+          if (!visited->get_bit(dst)) {
+            if (num_paths[dst]==0) {
+              active_out->set_bit(dst);
+            }
+            write_add(&num_paths[dst], msg);
+          }
+        }
+        return 0;
+      },
+      [&](VertexId dst, VertexAdjList<EdgeData> incoming_adj) {
+        if (visited->get_bit(dst)) return;
+        double sum = 0;
+        for (AdjUnit<EdgeData> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          VertexId src = ptr->neighbour;
+          if (active_in->get_bit(src)) {
+            sum += num_paths[src];
+          }
+        }
+        if (sum > 0) {
+          graph->emit(dst, sum);
+        }
+      },
+      [&](VertexId dst, double msg) {
+        if (!visited->get_bit(dst)) {
+          active_out->set_bit(dst);
+          write_add(&num_paths[dst], msg);
+        }
+        return 0;
+      },
+      active_in, visited
+    );
+    active_vertices = graph->template process_vertices<VertexId>(
+      [&](VertexId vtx) {
+        visited->set_bit(vtx);
+        return 1;
+      },
+      active_out
+    );
+    levels.push_back(active_out);
+    active_in = active_out;
+  }
+
+  double * inv_num_paths = num_paths;
+  graph->template process_vertices<VertexId>(
+    [&](VertexId vtx){
+      inv_num_paths[vtx] = 1 / num_paths[vtx];
+      dependencies[vtx] = 0;
+      return 1;
+    },
+    active_all
+  );
+  visited->clear();
+  graph->template process_vertices<VertexId>(
+    [&](VertexId vtx){
+      visited->set_bit(vtx);
+      dependencies[vtx] += inv_num_paths[vtx];
+      return 1;
+    },
+    levels.back()
+  );
+  graph->transpose();
+  while (levels.size() > 1) {
+    graph->template process_edges<VertexId,double>(
+      [&](VertexId src){
+        graph->emit(src, dependencies[src]);
+      },
+      [&](VertexId src, double msg, VertexAdjList<EdgeData> outgoing_adj){
+        for (AdjUnit<EdgeData> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+          VertexId dst = ptr->neighbour;
+          if (!visited->get_bit(dst)) {
+            write_add(&dependencies[dst], msg);
+          }
+        }
+        return 0;
+      },
+      [&](VertexId dst, VertexAdjList<EdgeData> incoming_adj) {
+        if (visited->get_bit(dst)) return;
+        double sum = 0;
+        for (AdjUnit<EdgeData> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+          VertexId src = ptr->neighbour;
+          if (levels.back()->get_bit(src)) {
+            sum += dependencies[src];
+          }
+        }
+        graph->emit(dst, sum);
+      },
+      [&](VertexId dst, double msg) {
+        if (!visited->get_bit(dst)) {
+          write_add(&dependencies[dst], msg);
+        }
+        return 0;
+      },
+      levels.back(), visited
+    );
+    pool.dealloc_vertex_subset(levels.back());
+    levels.pop_back();
+    graph->template process_vertices<VertexId>(
+      [&](VertexId vtx){
+        visited->set_bit(vtx);
+        dependencies[vtx] += inv_num_paths[vtx];
+        return 1;
+      },
+      levels.back()
+    );
+  }
+  graph->transpose();
+
+  graph->template process_vertices<VertexId>(
+    [&](VertexId vtx){
+      dependencies[vtx] = (dependencies[vtx] - inv_num_paths[vtx]) / inv_num_paths[vtx];
+      return 1;
+    },
+    active_all
+  );
+  std::pair<VertexId,double> max_dependency = graph->arg_max(dependencies, [&](VertexId vtx) { return vtx!=root && std::isfinite(dependencies[vtx]); });
+
+  pool.dealloc_vertex_array(num_paths);
+  pool.dealloc_vertex_array(dependencies);
+  pool.dealloc_vertex_subset(levels.back());
+  pool.dealloc_vertex_subset(visited);
+  pool.dealloc_vertex_subset(active_all);
+
+  char result[MAX_JOB_LENGTH];
+  snprintf(result, MAX_JOB_LENGTH, "dependencies[%lu]=%lf", max_dependency.first, max_dependency.second);
+  return result;
+}
+
+std::string run_sssp(Graph<Empty> * graph, VertexArrayPool<Empty> & pool, VertexId root) {
+  return "error: sssp needs a graph loaded with weights";
+}
+
+// the largest current and peak footprint over all ranks, as accounted by the engine
+template <typename EdgeData>
+std::string run_memory(Graph<EdgeData> * graph) {
+  long bytes[2] = {graph->memory.total(), graph->memory.peak()};
+  MPI_Allreduce(MPI_IN_PLACE, bytes, 2, MPI_LONG, MPI_MAX, MPI_COMM_WORLD);
+  char result[MAX_JOB_LENGTH];
+  snprintf(result, MAX_JOB_LENGTH, "rank_bytes<=%ld rank_peak_bytes<=%ld", bytes[0], bytes[1]);
+  return result;
+}
+
+// run one job on the resident graph; every rank calls this with the same job
+template <typename EdgeData>
+std::string run_job(Graph<EdgeData> * graph, VertexArrayPool<EdgeData> & pool, std::string job) {
+  std::istringstream parser(job);
+  std::string algorithm;
+  parser >> algorithm;
+  if (algorithm=="memory") {
+    return run_memory(graph);
+  }
+  // anything left after the arguments means a malformed job
+  std::string rest;
+  if (algorithm=="pagerank") {
+    int iterations = 20;
+    // a missing count keeps the default, a word that is not a number is rejected
+    if (!(parser >> iterations) && !parser.eof()) return "error: iterations must be a number";
+    parser.clear();
+    if (parser >> rest) return "error: unexpected '" + rest + "'";
+    if (iterations <= 0) return "error: iterations must be positive";
+    return run_pagerank(graph, pool, iterations);
+  }
+  if (algorithm!="bfs" && algorithm!="sssp" && algorithm!="bc") {
+    return "error: unknown job '" + algorithm + "' (pagerank [iterations], bfs [root], sssp [root], bc [root], memory, quit)";
+  }
+  VertexId root;
+  if (!(parser >> root)) {
+    return "error: root must be a vertex id";
+  }
+  if (parser >> rest) return "error: unexpected '" + rest + "'";
+  if (root >= graph->vertices) {
+    return "error: root out of range";
+  }
+  if (algorithm=="bfs") {
+    return run_bfs(graph, pool, root);
+  } else if (algorithm=="bc") {
+    return run_bc(graph, pool, root);
+  }
+  return run_sssp(graph, pool, root);
+}
+
+// rank 0 reads jobs from stdin, or from clients of a unix socket (one at a time); each job is broadcast to all ranks
+class JobSource {
+  int listen_fd;
+  FILE * client_in;
+  FILE * client_out;
+public:
+  JobSource(std::string socket_path) : listen_fd(-1), client_in(stdin), client_out(stdout) {
+    if (socket_path=="") return;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    assert(socket_path.size() < sizeof(addr.sun_path));
+    strcpy(addr.sun_path, socket_path.c_str());
+    unlink(socket_path.c_str());
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    assert(listen_fd!=-1);
+    assert(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr))==0);
+    assert(listen(listen_fd, 16)==0);
+    // a client that leaves before its answer must not take the server down: writes to it fail with EPIPE instead
+    signal(SIGPIPE, SIG_IGN);
+    client_in = NULL;
+    client_out = NULL;
+  }
+  ~JobSource() {
+    close_client();
+    if (listen_fd!=-1) {
+      close(listen_fd);
+    }
+  }
+  void close_client() {
+    if (listen_fd==-1 || client_in==NULL) return;
+    fclose(client_in);
+    fclose(client_out);
+    client_in = NULL;
+    client_out = NULL;
+  }
+  // returns false once no more jobs will arrive
+  bool next_job(char * job) {
+    while (true) {
+      if (client_in==NULL) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd==-1) {
+          // a client that gave up while queued is not worth a pause; anything else (e.g. out of descriptors) may
+          // persist, so it is logged and retried a second later
+          if (errno!=EINTR && errno!=ECONNABORTED) {
+            fprintf(stderr, "accept: %s\n", strerror(errno));
+            sleep(1);
+          }
+          continue;
+        }
+        client_in = fdopen(fd, "r");
+        client_out = fdopen(dup(fd), "w");
+      }
+      if (fgets(job, MAX_JOB_LENGTH, client_in)!=NULL) {
+        job[strcspn(job, "\r\n")] = '\0';
+        if (job[0]=='\0') continue;
+        return true;
+      }
+      if (listen_fd==-1) return false;
+      close_client();
+    }
+  }
+  // a client that has gone away is dropped, and the next one is served
+  void reply(std::string result) {
+    fprintf(client_out, "%s\n", result.c_str());
+    if (fflush(client_out)==EOF || ferror(client_out)) {
+      close_client();
+    }
+  }
+};
+
+template <typename EdgeData>
+void serve(Graph<EdgeData> * graph, std::string socket_path) {
+  VertexArrayPool<EdgeData> pool(graph);
+  JobSource * source = NULL;
+  if (graph->partition_id==0) {
+    source = new JobSource(socket_path);
+    printf("ready\n");
+    fflush(stdout);
+  }
+  char job[MAX_JOB_LENGTH];
+  while (true) {
+    if (graph->partition_id==0) {
+      if (!source->next_job(job)) {
+        strcpy(job, "quit");
+      }
+    }
+    MPI_Bcast(job, MAX_JOB_LENGTH, MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (strcmp(job, "quit")==0) break;
+    double exec_time = 0;
+    exec_time -= get_time();
+    std::string result = run_job(graph, pool, job);
+    exec_time += get_time();
+    if (graph->partition_id==0) {
+      char timing[64];
+      snprintf(timing, 64, " exec_time=%lf(s)", exec_time);
+      source->reply(result + timing);
+    }
+  }
+  if (graph->partition_id==0) {
+    delete source;
+  }
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<5) {
+    printf("server [threads] [file] [vertices] [weighted] [socket] [adjacency_dir]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+  VertexId vertices = std::strtoul(argv[3], &end, 10);
+  bool weighted = std::atoi(argv[4])!=0;
+  std::string socket_path = argc >= 6 ? argv[5] : "";
+  std::string adjacency_dir = argc >= 7 ? argv[6] : "";
+
+  if (weighted) {
+    Graph<Weight> * graph = new Graph<Weight>(threads);
+    graph->store_adjacency_in(adjacency_dir);
+    graph->load_directed(argv[2], vertices);
+    serve(graph, socket_path);
+    delete graph;
+  } else {
+    Graph<Empty> * graph = new Graph<Empty>(threads);
+    graph->store_adjacency_in(adjacency_dir);
+    graph->load_directed(argv[2], vertices);
+    serve(graph, socket_path);
+    delete graph;
+  }
+  return 0;
+}
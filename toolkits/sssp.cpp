@@ -29,12 +29,14 @@ void compute(Graph<Weight> * graph, VertexId root) {
   Weight * distance = graph->alloc_vertex_array<Weight>();
   VertexSubset * active_in = graph->alloc_vertex_subset();
   VertexSubset * active_out = graph->alloc_vertex_subset();
+  Accumulator<Weight, MinReduction<Weight>> * relaxed = graph->alloc_accumulator<Weight, MinReduction<Weight>>();
   active_in->clear();
   active_in->set_bit(root);
   graph->fill_vertex_array(distance, (Weight)1e9);
   distance[root] = (Weight)0;
   VertexId active_vertices = 1;
-  
+  VertexId relaxations = 0;
+
   for (int i_i=0;active_vertices>0;i_i++) {
     if (graph->partition_id==0) {
       printf("active(%d)>=%lu\n", i_i, active_vertices);
@@ -45,18 +47,14 @@ void compute(Graph<Weight> * graph, VertexId root) {
         graph->emit(src, distance[src]);
       },
       [&](VertexId src, Weight msg, VertexAdjList<Weight> outgoing_adj){
-        VertexId activated = 0;
         for (AdjUnit<Weight> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
           VertexId dst = ptr->neighbour;
           Weight relax_dist = msg + ptr->edge_data;
           if (relax_dist < distance[dst]) {
-            if (write_min(&distance[dst], relax_dist)) {
-              active_out->set_bit(dst);
-              activated += 1;
-            }
+            relaxed->add(dst, relax_dist);
           }
         }
-        return activated;
+        return 0;
       },
       [&](VertexId dst, VertexAdjList<Weight> incoming_adj) {
         Weight msg = 1e9;
@@ -81,28 +79,30 @@ void compute(Graph<Weight> * graph, VertexId root) {
       },
       active_in
     );
+    active_vertices += relaxed->flush(distance, active_out);
+    relaxations += active_vertices;
     std::swap(active_in, active_out);
   }
 
   exec_time += get_time();
   if (graph->partition_id==0) {
     printf("exec_time=%lf(s)\n", exec_time);
+    printf("relaxations=%lu\n", relaxations);
   }
 
-  graph->gather_vertex_array(distance, 0);
-  if (graph->partition_id==0) {
-    VertexId max_v_i = root;
-    for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
-      if (distance[v_i] < 1e9 && distance[v_i] > distance[max_v_i]) {
-        max_v_i = v_i;
-      }
+  std::pair<VertexId,Weight> max_distance = graph->arg_max(distance,
+    [&](VertexId vtx) {
+      return distance[vtx] < 1e9;
     }
-    printf("distance[%lu]=%f\n", max_v_i, distance[max_v_i]);
+  );
+  if (graph->partition_id==0) {
+    printf("distance[%lu]=%f\n", max_distance.first, max_distance.second);
   }
 
   graph->dealloc_vertex_array(distance);
   delete active_in;
   delete active_out;
+  delete relaxed;
 }
 
 int main(int argc, char ** argv) {
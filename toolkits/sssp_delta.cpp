@@ -0,0 +1,249 @@
+/*
+Copyright (c) 2014-2015 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <random>
+
+#include "core/graph.hpp"
+
+typedef float Weight;
+
+// pending vertices and their minimum tentative distance, counted in a single pass
+struct PendingStats {
+  VertexId vertices;
+  Weight min_distance;
+};
+
+struct PendingStatsReduction : UserReduction {
+  static PendingStats identity() {
+    return PendingStats{0, (Weight)1e9};
+  }
+  static void combine(PendingStats & a, const PendingStats & b) {
+    a.vertices += b.vertices;
+    if (b.min_distance < a.min_distance) {
+      a.min_distance = b.min_distance;
+    }
+  }
+};
+
+// delta = max_weight / average_degree, i.e. roughly one light edge per vertex and bucket
+Weight choose_delta(Graph<Weight> * graph) {
+  Weight max_weight = 0;
+  for (int s_i=0;s_i<graph->sockets;s_i++) {
+    AdjUnit<Weight> * adj_list = graph->outgoing_adj_list[s_i];
+    #pragma omp parallel for reduction(max:max_weight)
+    for (EdgeId e_i=0;e_i<graph->outgoing_edges[s_i];e_i++) {
+      if (adj_list[e_i].edge_data > max_weight) {
+        max_weight = adj_list[e_i].edge_data;
+      }
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &max_weight, 1, get_mpi_data_type<Weight>(), MPI_MAX, MPI_COMM_WORLD);
+  if (max_weight <= 0) {
+    return 1;
+  }
+  double average_degree = (double)graph->edges / graph->vertices;
+  if (average_degree < 1) {
+    return max_weight;
+  }
+  return max_weight / average_degree;
+}
+
+typedef Accumulator<Weight, MinReduction<Weight>> RelaxAccumulator;
+
+// relax the light (weight <= delta) or heavy (weight > delta) out-edges of active; improved vertices become pending
+VertexId relax(Graph<Weight> * graph, Weight * distance, VertexSubset * active, VertexSubset * pending, RelaxAccumulator * relaxed, Weight delta, bool light) {
+  VertexId activated = graph->process_edges<VertexId,Weight>(
+    [&](VertexId src){
+      graph->emit(src, distance[src]);
+    },
+    [&](VertexId src, Weight msg, VertexAdjList<Weight> outgoing_adj){
+      for (AdjUnit<Weight> * ptr=outgoing_adj.begin;ptr!=outgoing_adj.end;ptr++) {
+        if ((ptr->edge_data <= delta) != light) continue;
+        VertexId dst = ptr->neighbour;
+        Weight relax_dist = msg + ptr->edge_data;
+        if (relax_dist < distance[dst]) {
+          relaxed->add(dst, relax_dist);
+        }
+      }
+      return 0;
+    },
+    [&](VertexId dst, VertexAdjList<Weight> incoming_adj) {
+      Weight msg = 1e9;
+      for (AdjUnit<Weight> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+        if ((ptr->edge_data <= delta) != light) continue;
+        VertexId src = ptr->neighbour;
+        if (active->get_bit(src)) {
+          Weight relax_dist = distance[src] + ptr->edge_data;
+          if (relax_dist < msg) {
+            msg = relax_dist;
+          }
+        }
+      }
+      if (msg < 1e9) graph->emit(dst, msg);
+    },
+    [&](VertexId dst, Weight msg) {
+      if (msg < distance[dst]) {
+        write_min(&distance[dst], msg);
+        pending->set_bit(dst);
+        return 1;
+      }
+      return 0;
+    },
+    active
+  );
+  return activated + relaxed->flush(distance, pending);
+}
+
+void compute(Graph<Weight> * graph, VertexId root, Weight delta) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  Weight * distance = graph->alloc_vertex_array<Weight>();
+  VertexSubset * pending = graph->alloc_vertex_subset();
+  VertexSubset * next_pending = graph->alloc_vertex_subset();
+  VertexSubset * frontier = graph->alloc_vertex_subset();
+  VertexSubset * settled = graph->alloc_vertex_subset();
+  RelaxAccumulator * relaxed = graph->alloc_accumulator<Weight, MinReduction<Weight>>();
+  pending->clear();
+  pending->set_bit(root);
+  graph->fill_vertex_array(distance, (Weight)1e9);
+  distance[root] = (Weight)0;
+
+  VertexId relaxations = 0;
+  int buckets = 0;
+  while (true) {
+    // locate the lowest non-empty bucket
+    PendingStats stats = graph->process_vertices<PendingStats, PendingStatsReduction>(
+      [&](VertexId vtx) {
+        return PendingStats{1, distance[vtx]};
+      },
+      pending
+    );
+    if (stats.vertices==0) break;
+    Weight bucket_end = (floor(stats.min_distance / delta) + 1) * delta;
+    if (graph->partition_id==0) {
+      printf("bucket(%d)<%f pending>=%lu\n", buckets, bucket_end, stats.vertices);
+    }
+    buckets += 1;
+
+    // light phase: repeat until the bucket stops refilling; the vertices left pending are collected into a fresh
+    // subset rather than clearing bits, which would drop the queue that keeps sparse steps cheap
+    settled->clear();
+    while (true) {
+      frontier->clear();
+      next_pending->clear();
+      VertexId active_vertices = graph->process_vertices<VertexId>(
+        [&](VertexId vtx) {
+          if (distance[vtx] < bucket_end) {
+            frontier->set_bit(vtx);
+            settled->set_bit(vtx);
+            return 1;
+          }
+          next_pending->set_bit(vtx);
+          return 0;
+        },
+        pending
+      );
+      std::swap(pending, next_pending);
+      if (active_vertices==0) break;
+      relaxations += relax(graph, distance, frontier, pending, relaxed, delta, true);
+    }
+
+    // heavy phase: heavy edges cannot land in the current bucket, so each settled vertex relaxes them once
+    relaxations += relax(graph, distance, settled, pending, relaxed, delta, false);
+  }
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+    printf("relaxations=%lu\n", relaxations);
+  }
+
+  std::pair<VertexId,Weight> max_distance = graph->arg_max(distance,
+    [&](VertexId vtx) {
+      return distance[vtx] < 1e9;
+    }
+  );
+  if (graph->partition_id==0) {
+    printf("distance[%lu]=%f\n", max_distance.first, max_distance.second);
+  }
+
+  graph->dealloc_vertex_array(distance);
+  delete pending;
+  delete next_pending;
+  delete frontier;
+  delete settled;
+  delete relaxed;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  VertexId root;
+  int threads;
+
+  if(argc < 4) {
+	  printf("sssp_delta <threads> <file> <vertices> [source] [delta]\n");
+	  exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  VertexId vertices = std::strtoul(argv[3], &end, 10);
+  end = NULL;
+
+  if(argc >= 5) {
+	  root = std::strtoul(argv[4], &end, 10);
+  } else {
+	  // Setup random number generation for SSSP source
+	  std::random_device rdev;
+	  std::mt19937 gen(rdev()); // Seed for random generation
+	  std::uniform_int_distribution<unsigned long> udist(0, vertices - 1);
+	  root = udist(gen);
+	  // All MPI hosts must have the same source
+	  // Just choose the largest random number
+	  // across all machines
+	  MPI_Allreduce(MPI_IN_PLACE, &root, 1, MPI_UNSIGNED_LONG, MPI_MAX, MPI_COMM_WORLD);
+	  printf("Using randomly generated source vertex %lu\n", root);
+  }
+
+  Graph<Weight> * graph;
+  graph = new Graph<Weight>(threads);
+  graph->load_directed(argv[2], vertices);
+
+  Weight delta = 0;
+  if(argc >= 6) {
+	  delta = std::atof(argv[5]);
+  }
+  if(delta <= 0) {
+	  delta = choose_delta(graph);
+  }
+  if(graph->partition_id==0) {
+	  printf("delta = %f\n", delta);
+  }
+
+  compute(graph, root, delta);
+  for (int run=0;run<5;run++) {
+    compute(graph, root, delta);
+  }
+
+  delete graph;
+  return 0;
+}
@@ -0,0 +1,307 @@
+/*
+Copyright (c) 2015-2016 Xiaowei Zhu, Tsinghua University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "core/graph.hpp"
+
+// one list has to be this many times longer than the other before binary searches beat a merge
+#define GALLOP_RATIO 32
+// fetched_offset[] of a vertex whose list was not fetched
+#define NO_LIST ((EdgeId)-1)
+
+// galloping: every element of the short list is located in the long one with an exponential then a binary search
+template <typename F>
+void gallop(const VertexId * a, size_t na, const VertexId * b, size_t nb, F found) {
+  size_t j = 0;
+  for (size_t i=0;i<na && j<nb;i++) {
+    size_t step = 1;
+    while (j + step < nb && b[j + step] < a[i]) {
+      j += step;
+      step *= 2;
+    }
+    j = std::lower_bound(b + j, b + std::min(j + step + 1, nb), a[i]) - b;
+    if (j < nb && b[j] == a[i]) {
+      found(a[i]);
+    }
+  }
+}
+
+// calls found(w) for every w in both a and b, which are sorted and free of duplicates
+template <typename F>
+void intersect(const VertexId * a, size_t na, const VertexId * b, size_t nb, F found) {
+  if (na * GALLOP_RATIO < nb) {
+    gallop(a, na, b, nb, found);
+    return;
+  }
+  if (nb * GALLOP_RATIO < na) {
+    gallop(b, nb, a, na, found);
+    return;
+  }
+  size_t i = 0, j = 0;
+  #ifdef __AVX2__
+  // 4x4 blocks: a block of a is compared with all four rotations of a block of b, and the block
+  // with the smaller last element is consumed (both if they end on the same vertex)
+  while (i + 4 <= na && j + 4 <= nb) {
+    __m256i block_a = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i block_b = _mm256_loadu_si256((const __m256i *)(b + j));
+    __m256i match = _mm256_cmpeq_epi64(block_a, block_b);
+    for (int r_i=1;r_i<4;r_i++) {
+      block_b = _mm256_permute4x64_epi64(block_b, _MM_SHUFFLE(0, 3, 2, 1));
+      match = _mm256_or_si256(match, _mm256_cmpeq_epi64(block_a, block_b));
+    }
+    int mask = _mm256_movemask_pd(_mm256_castsi256_pd(match));
+    while (mask) {
+      found(a[i + __builtin_ctz(mask)]);
+      mask &= mask - 1;
+    }
+    VertexId last_a = a[i + 3];
+    VertexId last_b = b[j + 3];
+    if (last_a <= last_b) i += 4;
+    if (last_b <= last_a) j += 4;
+  }
+  #endif
+  while (i < na && j < nb) {
+    if (a[i] < b[j]) {
+      i++;
+    } else if (b[j] < a[i]) {
+      j++;
+    } else {
+      found(a[i]);
+      i++;
+      j++;
+    }
+  }
+}
+
+void compute(Graph<Empty> * graph, std::string output_path) {
+  double exec_time = 0;
+  exec_time -= get_time();
+
+  VertexId begin_v_i = graph->partition_offset[graph->partition_id];
+  VertexId end_v_i = graph->partition_offset[graph->partition_id+1];
+  VertexId owned_vertices = end_v_i - begin_v_i;
+  std::vector<EdgeId> index;
+  std::vector<AdjUnit<Empty> > adj;
+  graph->transpose_owned_adjacency(index, adj);
+
+  // the load already dropped self-loops and repeated edges, so only the order is missing; degree[] ends up
+  // complete on every rank
+  VertexId * degree = graph->alloc_vertex_array<VertexId>();
+  VertexId * triangles = graph->alloc_vertex_array<VertexId>();
+  #pragma omp parallel for
+  for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+    degree[v_i] = 0;
+    triangles[v_i] = 0;
+  }
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (VertexId v_i=0;v_i<owned_vertices;v_i++) {
+    std::sort(adj.begin() + index[v_i], adj.begin() + index[v_i+1], adj_unit_less<Empty>);
+    degree[begin_v_i + v_i] = index[v_i+1] - index[v_i];
+  }
+  MPI_Allreduce(MPI_IN_PLACE, degree, graph->vertices, get_mpi_data_type<VertexId>(), MPI_SUM, MPI_COMM_WORLD);
+
+  // orient every edge from the lower- to the higher-degree endpoint (ties broken by id), so that each
+  // triangle is found exactly once and no vertex keeps more than O(sqrt(|E|)) out-neighbours
+  auto precedes = [&](VertexId u, VertexId v) {
+    return degree[u] < degree[v] || (degree[u] == degree[v] && u < v);
+  };
+  std::vector<EdgeId> oriented_index(owned_vertices + 1, 0);
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (VertexId v_i=0;v_i<owned_vertices;v_i++) {
+    VertexId vtx = begin_v_i + v_i;
+    for (EdgeId e_i=index[v_i];e_i<index[v_i]+degree[vtx];e_i++) {
+      if (precedes(vtx, adj[e_i].neighbour)) {
+        oriented_index[v_i+1] += 1;
+      }
+    }
+  }
+  for (VertexId v_i=0;v_i<owned_vertices;v_i++) {
+    oriented_index[v_i+1] += oriented_index[v_i];
+  }
+  std::vector<VertexId> oriented(oriented_index[owned_vertices]);
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (VertexId v_i=0;v_i<owned_vertices;v_i++) {
+    VertexId vtx = begin_v_i + v_i;
+    EdgeId o_i = oriented_index[v_i];
+    for (EdgeId e_i=index[v_i];e_i<index[v_i]+degree[vtx];e_i++) {
+      if (precedes(vtx, adj[e_i].neighbour)) {
+        oriented[o_i++] = adj[e_i].neighbour;
+      }
+    }
+  }
+  std::vector<AdjUnit<Empty> >().swap(adj);
+
+  // every rank needs the oriented lists of the remote out-neighbours of its vertices, and only those: in a dense step,
+  // the signal of a remote vertex u runs on each rank owning neighbours v of u and sends u's owner the lists of the v
+  // that follow u, each at most once per rank (sent_to[v] holds the rank v's list was last claimed for)
+  int * sent_to = graph->alloc_vertex_array<int>();
+  EdgeId * fetched_offset = graph->alloc_vertex_array<EdgeId>();
+  #pragma omp parallel for
+  for (VertexId v_i=0;v_i<graph->vertices;v_i++) {
+    sent_to[v_i] = -1;
+    fetched_offset[v_i] = NO_LIST;
+  }
+  // entries are (vertex, length, oriented list)
+  std::vector<std::vector<VertexId> > outgoing(graph->threads);
+  std::vector<std::vector<VertexId> > fetched_parts(graph->threads);
+  VertexSubset * active = graph->alloc_vertex_subset();
+  active->fill();
+  graph->process_edges_list<VertexId,VertexId>(
+    [&](VertexId src) {
+      assert(false); // every vertex is active, so the step is dense
+    },
+    [&](VertexId src, const VertexId * msg, size_t length, VertexAdjList<Empty> outgoing_adj) {
+      return 0;
+    },
+    [&](VertexId u, VertexAdjList<Empty> incoming_adj) {
+      int u_part = graph->get_partition_id(u);
+      if (u_part==graph->partition_id) return;
+      std::vector<VertexId> & entries = outgoing[omp_get_thread_num()];
+      entries.clear();
+      for (AdjUnit<Empty> * ptr=incoming_adj.begin;ptr!=incoming_adj.end;ptr++) {
+        VertexId v = ptr->neighbour;
+        VertexId v_i = v - begin_v_i;
+        if (!precedes(u, v) || oriented_index[v_i]==oriented_index[v_i+1]) continue;
+        int last = sent_to[v];
+        if (last==u_part || !cas(&sent_to[v], last, u_part)) continue;
+        entries.push_back(v);
+        entries.push_back(oriented_index[v_i+1] - oriented_index[v_i]);
+        entries.insert(entries.end(), oriented.begin() + oriented_index[v_i], oriented.begin() + oriented_index[v_i+1]);
+      }
+      if (!entries.empty()) {
+        graph->emit_list(u, entries.data(), entries.size());
+      }
+    },
+    [&](VertexId u, const VertexId * msg, size_t length) {
+      std::vector<VertexId> & part = fetched_parts[omp_get_thread_num()];
+      part.insert(part.end(), msg, msg + length);
+      return 0;
+    },
+    active
+  );
+  std::vector<VertexId> fetched;
+  for (int t_i=0;t_i<graph->threads;t_i++) {
+    fetched.insert(fetched.end(), fetched_parts[t_i].begin(), fetched_parts[t_i].end());
+    std::vector<VertexId>().swap(fetched_parts[t_i]);
+  }
+  for (EdgeId f_i=0;f_i<fetched.size();f_i+=2+fetched[f_i+1]) {
+    fetched_offset[fetched[f_i]] = f_i;
+  }
+  graph->dealloc_vertex_array(sent_to);
+
+  // every rank intersects the lists of its own vertices with those of their out-neighbours
+  VertexId found_triangles = 0;
+  #pragma omp parallel for schedule(dynamic, 64) reduction(+:found_triangles)
+  for (VertexId v_i=0;v_i<owned_vertices;v_i++) {
+    VertexId u = begin_v_i + v_i;
+    const VertexId * u_begin = oriented.data() + oriented_index[v_i];
+    const VertexId * u_end = oriented.data() + oriented_index[v_i+1];
+    for (const VertexId * ptr=u_begin;ptr!=u_end;ptr++) {
+      VertexId v = *ptr;
+      const VertexId * v_list;
+      size_t v_length;
+      if (v >= begin_v_i && v < end_v_i) {
+        v_list = oriented.data() + oriented_index[v - begin_v_i];
+        v_length = oriented_index[v - begin_v_i + 1] - oriented_index[v - begin_v_i];
+      } else if (fetched_offset[v]!=NO_LIST) {
+        v_list = fetched.data() + fetched_offset[v] + 2;
+        v_length = fetched[fetched_offset[v] + 1];
+      } else {
+        continue;
+      }
+      intersect(u_begin, u_end - u_begin, v_list, v_length, [&](VertexId w){
+        found_triangles += 1;
+        write_add(&triangles[u], (VertexId)1);
+        write_add(&triangles[v], (VertexId)1);
+        write_add(&triangles[w], (VertexId)1);
+      });
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &found_triangles, 1, get_mpi_data_type<VertexId>(), MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, triangles, graph->vertices, get_mpi_data_type<VertexId>(), MPI_SUM, MPI_COMM_WORLD);
+
+  exec_time += get_time();
+  if (graph->partition_id==0) {
+    printf("exec_time=%lf(s)\n", exec_time);
+  }
+
+  if (output_path!="") {
+    graph->dump_vertex_array(triangles, output_path);
+  }
+
+  double clustering = graph->process_vertices<double>(
+    [&](VertexId vtx) {
+      if (degree[vtx] < 2) return 0.0;
+      return 2.0 * triangles[vtx] / degree[vtx] / (degree[vtx] - 1);
+    },
+    active
+  );
+  std::pair<VertexId,VertexId> most = graph->arg_max(triangles);
+  if (graph->partition_id==0) {
+    printf("triangles = %lu\n", found_triangles);
+    printf("average clustering coefficient = %lf\n", clustering / graph->vertices);
+    printf("triangles[%lu]=%lu\n", most.first, most.second);
+  }
+
+  graph->dealloc_vertex_array(degree);
+  graph->dealloc_vertex_array(triangles);
+  graph->dealloc_vertex_array(fetched_offset);
+  delete active;
+}
+
+int main(int argc, char ** argv) {
+  MPI_Instance mpi(&argc, &argv);
+  char *end;
+  int threads;
+
+  if (argc<4) {
+    printf("triangle [threads] [file] [vertices] [output] [symmetric]\n");
+    exit(-1);
+  }
+
+  threads = std::atoi(argv[1]);
+  assert(threads > 0);
+
+  Graph<Empty> * graph;
+  graph = new Graph<Empty>(threads);
+  graph->sort_adjacency_on_load(true);
+  // a file that already lists both directions of every edge is stored as it is
+  bool symmetric = argc >= 6 && std::atoi(argv[5])!=0;
+  if (symmetric) {
+    graph->load_symmetric(argv[2], std::strtoul(argv[3], &end, 10));
+  } else {
+    graph->load_undirected_from_directed(argv[2], std::strtoul(argv[3], &end, 10));
+  }
+
+  std::string output_path = argc >= 5 ? argv[4] : "";
+
+  compute(graph, output_path);
+  for (int run=0;run<5;run++) {
+    compute(graph, output_path);
+  }
+
+  delete graph;
+  return 0;
+}